@@ -13,25 +13,57 @@ SOURCES += \
     checkversion.cpp \
     dfft.c \
     download.cpp \
+    drbgproducer.cpp \
     globalval.cpp \
     handleziptype.cpp \
     main.cpp \
+    mappedfile.cpp \
     matrix.c \
     qrserver.cpp \
+    randomworker.cpp \
+    rfft.c \
     sts.c
 
 HEADERS += \
     checkversion.h \
     download.h \
+    drbgproducer.h \
     globalval.h \
     handleziptype.h \
+    mappedfile.h \
     qrserver.h \
+    randomworker.h \
+    rfft_impl.h \
     sts.h
 
 target.path = /home/quakey/qt_out
 INSTALLS += target
 
 DISTFILES += \
-    libhash/Makefile
+    libdrbg/Makefile \
+    libdrbg/libhash/Makefile \
+    stsbench/Makefile
 
 LIBS += -lwiringPi
+
+# libdrbg静态库,宏定义必须与libdrbg/Makefile默认配置一致(drbg_ctx结构体布局依赖这些宏)
+DEFINES += WITH_HASH_DRBG WITH_HMAC_DRBG WITH_CTR_DRBG WITH_BC_TDEA WITH_BC_AES \
+    STRICT_NIST_SP800_90A WITH_HASH_CONF_OVERRIDE \
+    WITH_HASH_SHA1 WITH_HASH_SHA224 WITH_HASH_SHA256 WITH_HASH_SHA384 \
+    WITH_HASH_SHA512 WITH_HASH_SHA512_224 WITH_HASH_SHA512_256
+INCLUDEPATH += $$PWD/libdrbg $$PWD/libdrbg/libhash $$PWD/libdrbg/aes
+LIBS += -L$$PWD/libdrbg -ldrbg -L$$PWD/libdrbg/libhash -lhash -lpthread
+
+# 源文件或头文件变化时从头重建,Makefile里.o不依赖头文件,增量编译会混入旧的目标文件
+libdrbg.target = $$PWD/libdrbg/libdrbg.a
+for(dir, $$list(libdrbg libdrbg/aes libdrbg/libhash libdrbg/drbg_tests)): \
+    libdrbg.depends += $$files($$PWD/$$dir/*.c) $$files($$PWD/$$dir/*.h)
+libdrbg.depends += $$PWD/libdrbg/Makefile $$PWD/libdrbg/libhash/Makefile
+libdrbg.commands = cd $$PWD/libdrbg && $(MAKE) clean && $(MAKE) libdrbg.a
+QMAKE_EXTRA_TARGETS += libdrbg
+PRE_TARGETDEPS += $$PWD/libdrbg/libdrbg.a
+
+# NIST测试基准程序(不依赖Qt,不参与QRServer构建): make stsbench
+stsbench.target = stsbench
+stsbench.commands = cd $$PWD/stsbench && $(MAKE)
+QMAKE_EXTRA_TARGETS += stsbench
@@ -12,7 +12,7 @@ double PI     = 3.14159265358979323846;			// pi, duh!
 static double big = 4.503599627370496e15;
 static double biginv =  2.22044604925031308085e-16;
 
-int sgngam = 0;
+__thread int sgngam = 0;
 
 double
 cephes_igamc(double a, double x)
@@ -0,0 +1,128 @@
+#include "drbgproducer.h"
+#include <QFile>
+#include <QDebug>
+#include <string.h>
+
+DrbgProducer::DrbgProducer(const QByteArray &persString)
+    : m_instantiated(false), m_persString(persString)
+{
+    memset(&m_ctx, 0, sizeof(m_ctx));
+}
+
+DrbgProducer::~DrbgProducer()
+{
+    uninstantiate();
+}
+
+/**
+ * 实例化CTR-DRBG(AES256,使用DF,开启预测抗性)
+ * 熵和nonce由libdrbg通过get_entropy_input从立方体取得
+ */
+bool DrbgProducer::instantiate()
+{
+    if (m_instantiated) {
+        return true;
+    }
+
+    drbg_options opt;
+    DRBG_CTR_OPTIONS_INIT(opt, CTR_DRBG_BC_AES256, true, 0);
+    drbg_error ret = drbg_instantiate(&m_ctx,
+                                      reinterpret_cast<const uint8_t *>(m_persString.constData()),
+                                      static_cast<uint32_t>(m_persString.size()),
+                                      NULL, true, DRBG_CTR, &opt);
+    if (ret != DRBG_OK) {
+        qDebug() << "DRBG实例化失败,错误码:" << ret;
+        drbg_uninstantiate(&m_ctx);
+        return false;
+    }
+
+    m_instantiated = true;
+    return true;
+}
+
+void DrbgProducer::uninstantiate()
+{
+    if (m_instantiated) {
+        drbg_uninstantiate(&m_ctx);
+        m_instantiated = false;
+    }
+}
+
+bool DrbgProducer::isInstantiated() const
+{
+    return m_instantiated;
+}
+
+/**
+ * 生成size字节随机数并写入filePath(覆盖原有内容)
+ * 每chunkSize字节调用一次带预测抗性的generate
+ */
+bool DrbgProducer::generateToFile(const QString &filePath, qint64 size, const ChunkCallback &onChunk)
+{
+    if (!m_instantiated && !instantiate()) {
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "打开文件失败:" << filePath;
+        return false;
+    }
+
+    unsigned char output[chunkSize];
+    bool ok = true;
+    qint64 remain = size;
+    while (remain > 0) {
+        uint32_t len = static_cast<uint32_t>(qMin<qint64>(remain, chunkSize));
+        drbg_error ret = drbg_generate(&m_ctx, NULL, 0, output, len, true);
+        if (ret != DRBG_OK) {
+            qDebug() << "DRBG生成随机数失败,错误码:" << ret;
+            //下次调用时重新实例化
+            uninstantiate();
+            ok = false;
+            break;
+        }
+        if (file.write(reinterpret_cast<const char *>(output), len) != len) {
+            qDebug() << "写入随机数文件失败:" << file.errorString();
+            ok = false;
+            break;
+        }
+        if (onChunk) {
+            onChunk(output, static_cast<int>(len));
+        }
+        remain -= len;
+    }
+    memset(output, 0, sizeof(output));
+    file.close();
+
+    return ok;
+}
+
+/**
+ * 暂停熵源并释放串口(ttyACM0),供global_port独占使用
+ * 正在进行的补充在当前指令结束后停止,返回时串口已关闭;之后的补充阻塞到resumeEntropySource
+ * 熵池中已有的熵仍可取用,暂停与恢复必须成对调用
+ */
+void DrbgProducer::suspendEntropySource()
+{
+    entropy_source_suspend();
+}
+
+void DrbgProducer::resumeEntropySource()
+{
+    entropy_source_resume();
+}
+
+/**
+ * 熵源串口累计占用时间(微秒),用于估算熵带宽是否已饱和
+ */
+bool DrbgProducer::entropyBusyTime(quint64 &busyUs)
+{
+    uint64_t delivered = 0;
+    uint64_t busy = 0;
+    if (entropy_source_get_stats(&delivered, &busy)) {
+        return false;
+    }
+    busyUs = busy;
+    return true;
+}
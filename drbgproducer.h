@@ -0,0 +1,48 @@
+#ifndef DRBGPRODUCER_H
+#define DRBGPRODUCER_H
+
+#include <QString>
+#include <QByteArray>
+#include <functional>
+
+extern "C" {
+#include "drbg.h"
+#include "entropy.h"
+}
+
+/**
+ * 进程内的CTR-DRBG随机数生成器
+ * 整个生命周期只实例化一次drbg_ctx，一次调用即可流式写满一个随机数文件
+ * 同一实例同一时间只能在一个线程中使用,不同实例可并行
+ */
+class DrbgProducer
+{
+public:
+    explicit DrbgProducer(const QByteArray &persString = QByteArray("DRBG_PERS"));
+    ~DrbgProducer();
+
+    bool instantiate();
+    void uninstantiate();
+    bool isInstantiated() const;
+
+    //每写入一块随机数后回调,用于边生成边测试和计算哈希
+    typedef std::function<void(const unsigned char *data, int len)> ChunkCallback;
+
+    bool generateToFile(const QString &filePath, qint64 size, const ChunkCallback &onChunk = ChunkCallback());
+
+    static void suspendEntropySource();
+    static void resumeEntropySource();
+    static bool entropyBusyTime(quint64 &busyUs);
+
+    static const int chunkSize = 1024;//每次generate输出的字节数,每块都会用新熵重新播种
+
+private:
+    drbg_ctx m_ctx;
+    bool m_instantiated;
+    QByteArray m_persString;//个性化字符串
+
+    DrbgProducer(const DrbgProducer &) = delete;
+    DrbgProducer &operator=(const DrbgProducer &) = delete;
+};
+
+#endif // DRBGPRODUCER_H
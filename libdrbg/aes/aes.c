@@ -10,6 +10,8 @@
 
 #ifdef WITH_BC_AES
 #include "aes.h"
+#include "aes_hw.h"
+#include "aes_bs.h"
 
 #ifndef USED_ATTR
 #define USED_ATTR __attribute__((used))
@@ -297,6 +299,13 @@ int aes_enc(aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[1
 	if((16 * (ctx->nr + 1)) > sizeof(ctx->rk)){
 		goto err;
 	}
+#ifdef WITH_AES_HW
+	if((ctx->nr != 0) && (aes_get_impl() == AES_IMPL_HW)){
+		aes_hw_enc(ctx, data_in, data_out);
+		ret = 0;
+		goto err;
+	}
+#endif
 	local_copy(state, data_in, 16);
 
 	/* Initial add round key */
@@ -965,6 +974,14 @@ int aes_setkey_enc(aes_core_context *ctx, const uint8_t *key, uint32_t keybits)
 	if((ctx == NULL) || (key == NULL)){
 		goto err;
 	}
+#ifdef WITH_AES_BITSLICE
+	ctx->bs_ready = 0;
+	/* No secret dependent table lookup in the key schedule either */
+	if(aes_get_impl() == AES_IMPL_BITSLICE){
+		ret = aes_bs_setkey_enc(ctx, key, keybits);
+		goto err;
+	}
+#endif
 	if(keybits == 128){
 		ctx->nr = 10;
 	}
@@ -1087,6 +1104,20 @@ int aes_enc(aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[1
 	if((ctx->nr >> 1) == 0){
 		goto err;
 	}
+#ifdef WITH_AES_HW
+	if(aes_get_impl() == AES_IMPL_HW){
+		aes_hw_enc(ctx, data_in, data_out);
+		ret = 0;
+		goto err;
+	}
+#endif
+#ifdef WITH_AES_BITSLICE
+	if(aes_get_impl() == AES_IMPL_BITSLICE){
+		aes_bs_enc_blocks(ctx, data_in, data_out, 1);
+		ret = 0;
+		goto err;
+	}
+#endif
 
 	/* Go for AES rounds */
 	RK = (uint32_t*)ctx->rk;
@@ -1162,6 +1193,10 @@ int aes_setkey_dec(aes_core_context *ctx, const uint8_t *key, uint32_t keybits)
 		goto err;
 	}
 	ctx->nr = ctxx.nr;
+#ifdef WITH_AES_BITSLICE
+	/* The bitsliced round keys are for encryption only */
+	ctx->bs_ready = 0;
+#endif
 
 	/* Now modify the context accordingly to decryption 
 	 * by reversing the key order.
@@ -1293,6 +1328,98 @@ err:
 
 #endif
 
+/* Implementation selected by aes_set_impl() */
+static int aes_impl_selected = AES_IMPL_AUTO;
+
+int aes_set_impl(aes_impl impl)
+{
+	int ret = -1;
+
+	switch(impl){
+		case AES_IMPL_AUTO:
+		case AES_IMPL_PORTABLE:{
+			break;
+		}
+#ifdef WITH_AES_HW
+		case AES_IMPL_HW:{
+			if(!aes_hw_available()){
+				goto err;
+			}
+			break;
+		}
+#endif
+#ifdef WITH_AES_BITSLICE
+		case AES_IMPL_BITSLICE:{
+			break;
+		}
+#endif
+		default:{
+			goto err;
+		}
+	}
+	__atomic_store_n(&aes_impl_selected, (int)impl, __ATOMIC_RELAXED);
+
+	ret = 0;
+
+err:
+	return ret;
+}
+
+aes_impl aes_get_impl(void)
+{
+	aes_impl impl = (aes_impl)__atomic_load_n(&aes_impl_selected, __ATOMIC_RELAXED);
+
+	if(impl != AES_IMPL_AUTO){
+		return impl;
+	}
+#ifdef WITH_AES_HW
+	if(aes_hw_available()){
+		return AES_IMPL_HW;
+	}
+#endif
+#ifdef WITH_AES_BITSLICE
+	return AES_IMPL_BITSLICE;
+#else
+	return AES_IMPL_PORTABLE;
+#endif
+}
+
+/* Multiple blocks encryption, pipelined with the AES instructions or bitsliced */
+int aes_enc_blocks(aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks)
+{
+	uint32_t i;
+	int ret = -1;
+
+	if((ctx == NULL) || (data_in == NULL) || (data_out == NULL)){
+		goto err;
+	}
+#ifdef WITH_AES_HW
+	/* Sanity check for array access */
+	if((ctx->nr != 0) && ((16 * (ctx->nr + 1)) <= sizeof(ctx->rk)) && (aes_get_impl() == AES_IMPL_HW)){
+		aes_hw_enc_blocks(ctx, data_in, data_out, nblocks);
+		ret = 0;
+		goto err;
+	}
+#endif
+#ifdef WITH_AES_BITSLICE
+	if(((ctx->nr >> 1) != 0) && ((16 * (ctx->nr + 1)) <= sizeof(ctx->rk)) && (aes_get_impl() == AES_IMPL_BITSLICE)){
+		aes_bs_enc_blocks(ctx, data_in, data_out, nblocks);
+		ret = 0;
+		goto err;
+	}
+#endif
+	for(i = 0; i < nblocks; i++){
+		if(aes_enc(ctx, &data_in[16 * i], &data_out[16 * i])){
+			goto err;
+		}
+	}
+
+	ret = 0;
+
+err:
+	return ret;
+}
+
 #else /* !WITH_BC_AES */
 /*
  * Dummy definition to avoid the empty translation unit ISO C warning
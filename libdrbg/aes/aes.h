@@ -27,6 +27,15 @@
 #define TABLE_AES
 #endif
 
+/*
+ * Constant time bitsliced AES (see aes_bs.h), on top of the table based
+ * AES key schedule. It keeps the round keys as bit planes in the context,
+ * define NO_AES_BITSLICE to leave it out.
+ */
+#if defined(TABLE_AES) && !defined(NO_AES_BITSLICE) && (defined(__GNUC__) || defined(__clang__))
+#define WITH_AES_BITSLICE
+#endif
+
 #define AES_BLOCK_SIZE  16
 
 typedef struct
@@ -38,6 +47,10 @@ typedef struct
 #ifdef  TABLE_AES
 	uint32_t rk[64]; /* AES round keys  */
 #endif
+#ifdef WITH_AES_BITSLICE
+	uint64_t bs_rk[8 * 16]; /* Bitsliced round keys, from rk */
+	uint32_t bs_ready;      /* bs_rk is up to date */
+#endif
 }
 aes_core_context;
 
@@ -46,6 +59,26 @@ enum {
 	AES_DEC = 1
 };
 
+/*
+ * AES implementation used for encryption. AES_IMPL_AUTO takes the AES
+ * instructions when the CPU has them, else the bitsliced AES when it is
+ * built, else the portable AES.
+ */
+typedef enum {
+	AES_IMPL_AUTO     = 0,
+	AES_IMPL_PORTABLE = 1,
+	AES_IMPL_HW       = 2,
+	AES_IMPL_BITSLICE = 3
+} aes_impl;
+
+/* Select the implementation (at any time, keyed contexts stay valid).
+ * Returns -1 if it is not built in or not supported by the CPU.
+ */
+int aes_set_impl(aes_impl impl);
+
+/* The implementation in use (never AES_IMPL_AUTO) */
+aes_impl aes_get_impl(void);
+
 enum aes_key_len {
     AES128 = 0,
     AES192 = 1,
@@ -69,6 +102,9 @@ int aes_setkey_dec(aes_core_context *ctx, const uint8_t *key, uint32_t keybits);
 
 int aes_enc(aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[16]);
 
+/* Encrypt nblocks independent blocks (ECB), in place or not */
+int aes_enc_blocks(aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks);
+
 int aes_dec(aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[16]);
 
 
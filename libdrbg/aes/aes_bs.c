@@ -0,0 +1,502 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifdef WITH_BC_AES
+#include "aes_bs.h"
+#endif
+
+#ifdef WITH_AES_BITSLICE
+#include <string.h>
+
+/*
+ * The representation is the one of the "ct64" AES of BearSSL (Thomas
+ * Pornin): four blocks are spread over eight 64-bit words, word i holding
+ * bit i of every byte. Here each word is a vector of two 64-bit lanes, so
+ * that eight blocks are processed with the same instructions.
+ */
+typedef uint64_t aes_bs_word __attribute__((vector_size(16)));
+
+#define AES_BS_BLOCKS	8
+
+/* Bitsliced S-box: the circuit of Boyar and Peralta */
+static void aes_bs_sbox(aes_bs_word *q)
+{
+	aes_bs_word x0, x1, x2, x3, x4, x5, x6, x7;
+	aes_bs_word y1, y2, y3, y4, y5, y6, y7, y8, y9;
+	aes_bs_word y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+	aes_bs_word y20, y21;
+	aes_bs_word z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	aes_bs_word z10, z11, z12, z13, z14, z15, z16, z17;
+	aes_bs_word t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	aes_bs_word t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	aes_bs_word t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	aes_bs_word t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	aes_bs_word t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	aes_bs_word t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	aes_bs_word t60, t61, t62, t63, t64, t65, t66, t67;
+	aes_bs_word s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	/* Top linear transformation */
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	/* Non-linear section */
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	/* Bottom linear transformation */
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0;
+	q[6] = s1;
+	q[5] = s2;
+	q[4] = s3;
+	q[3] = s4;
+	q[2] = s5;
+	q[1] = s6;
+	q[0] = s7;
+}
+
+/* Transposition between four interleaved blocks and the bit planes (an involution) */
+#define AES_BS_SWAPN(cl, ch, s, x, y) do {				\
+	aes_bs_word a_ = (x), b_ = (y);					\
+	(x) = (a_ & (uint64_t)(cl)) | ((b_ & (uint64_t)(cl)) << (s));	\
+	(y) = ((a_ & (uint64_t)(ch)) >> (s)) | (b_ & (uint64_t)(ch));	\
+} while(0)
+#define AES_BS_SWAP2(x, y)	AES_BS_SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, x, y)
+#define AES_BS_SWAP4(x, y)	AES_BS_SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, x, y)
+#define AES_BS_SWAP8(x, y)	AES_BS_SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, x, y)
+
+static void aes_bs_ortho(aes_bs_word *q)
+{
+	AES_BS_SWAP2(q[0], q[1]);
+	AES_BS_SWAP2(q[2], q[3]);
+	AES_BS_SWAP2(q[4], q[5]);
+	AES_BS_SWAP2(q[6], q[7]);
+
+	AES_BS_SWAP4(q[0], q[2]);
+	AES_BS_SWAP4(q[1], q[3]);
+	AES_BS_SWAP4(q[4], q[6]);
+	AES_BS_SWAP4(q[5], q[7]);
+
+	AES_BS_SWAP8(q[0], q[4]);
+	AES_BS_SWAP8(q[1], q[5]);
+	AES_BS_SWAP8(q[2], q[6]);
+	AES_BS_SWAP8(q[3], q[7]);
+}
+
+/* The four little endian words of a block, spread over two 64-bit words */
+static void aes_bs_interleave_in(uint64_t *q0, uint64_t *q1, const uint32_t *w)
+{
+	uint64_t x0, x1, x2, x3;
+
+	x0 = w[0];
+	x1 = w[1];
+	x2 = w[2];
+	x3 = w[3];
+	x0 |= (x0 << 16);
+	x1 |= (x1 << 16);
+	x2 |= (x2 << 16);
+	x3 |= (x3 << 16);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	x0 |= (x0 << 8);
+	x1 |= (x1 << 8);
+	x2 |= (x2 << 8);
+	x3 |= (x3 << 8);
+	x0 &= 0x00FF00FF00FF00FFULL;
+	x1 &= 0x00FF00FF00FF00FFULL;
+	x2 &= 0x00FF00FF00FF00FFULL;
+	x3 &= 0x00FF00FF00FF00FFULL;
+	*q0 = x0 | (x2 << 8);
+	*q1 = x1 | (x3 << 8);
+}
+
+static void aes_bs_interleave_out(uint32_t *w, uint64_t q0, uint64_t q1)
+{
+	uint64_t x0, x1, x2, x3;
+
+	x0 = q0 & 0x00FF00FF00FF00FFULL;
+	x1 = q1 & 0x00FF00FF00FF00FFULL;
+	x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+	x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+	x0 |= (x0 >> 8);
+	x1 |= (x1 >> 8);
+	x2 |= (x2 >> 8);
+	x3 |= (x3 >> 8);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+	w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+	w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+	w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+/*
+ * Eight blocks (as little endian words) to bit planes: lane l of the
+ * planes holds blocks 4l to 4l+3.
+ */
+static void aes_bs_load(aes_bs_word *q, const uint32_t *w)
+{
+	uint64_t lanes[2][8];
+	unsigned int i, l;
+
+	for(l = 0; l < 2; l++){
+		for(i = 0; i < 4; i++){
+			aes_bs_interleave_in(&lanes[l][i], &lanes[l][i + 4], &w[4 * (4 * l + i)]);
+		}
+	}
+	for(i = 0; i < 8; i++){
+		uint64_t pair[2] = { lanes[0][i], lanes[1][i] };
+		memcpy(&q[i], pair, sizeof(pair));
+	}
+	aes_bs_ortho(q);
+}
+
+static void aes_bs_store(uint32_t *w, aes_bs_word *q)
+{
+	uint64_t lanes[2][8];
+	unsigned int i, l;
+
+	aes_bs_ortho(q);
+	for(i = 0; i < 8; i++){
+		uint64_t pair[2];
+		memcpy(pair, &q[i], sizeof(pair));
+		lanes[0][i] = pair[0];
+		lanes[1][i] = pair[1];
+	}
+	for(l = 0; l < 2; l++){
+		for(i = 0; i < 4; i++){
+			aes_bs_interleave_out(&w[4 * (4 * l + i)], lanes[l][i], lanes[l][i + 4]);
+		}
+	}
+}
+
+/* SubBytes of the four bytes of a word, for the key schedule */
+static uint32_t aes_bs_sub_word(uint32_t x)
+{
+	aes_bs_word q[8];
+	uint64_t pair[2] = { x, 0 };
+
+	memset(q, 0, sizeof(q));
+	memcpy(&q[0], pair, sizeof(pair));
+	aes_bs_ortho(q);
+	aes_bs_sbox(q);
+	aes_bs_ortho(q);
+	memcpy(pair, &q[0], sizeof(pair));
+	memset(q, 0, sizeof(q));
+	return (uint32_t)pair[0];
+}
+
+static void aes_bs_shift_rows(aes_bs_word *q)
+{
+	unsigned int i;
+
+	for(i = 0; i < 8; i++){
+		aes_bs_word x = q[i];
+		q[i] = (x & 0x000000000000FFFFULL)
+			| ((x & 0x00000000FFF00000ULL) >> 4)
+			| ((x & 0x00000000000F0000ULL) << 12)
+			| ((x & 0x0000FF0000000000ULL) >> 8)
+			| ((x & 0x000000FF00000000ULL) << 8)
+			| ((x & 0xF000000000000000ULL) >> 12)
+			| ((x & 0x0FFF000000000000ULL) << 4);
+	}
+}
+
+#define AES_BS_ROTR16(x)	(((x) >> 16) | ((x) << 48))
+#define AES_BS_ROTR32(x)	(((x) >> 32) | ((x) << 32))
+
+static void aes_bs_mix_columns(aes_bs_word *q)
+{
+	aes_bs_word q0, q1, q2, q3, q4, q5, q6, q7;
+	aes_bs_word r0, r1, r2, r3, r4, r5, r6, r7;
+
+	q0 = q[0];
+	q1 = q[1];
+	q2 = q[2];
+	q3 = q[3];
+	q4 = q[4];
+	q5 = q[5];
+	q6 = q[6];
+	q7 = q[7];
+	r0 = AES_BS_ROTR16(q0);
+	r1 = AES_BS_ROTR16(q1);
+	r2 = AES_BS_ROTR16(q2);
+	r3 = AES_BS_ROTR16(q3);
+	r4 = AES_BS_ROTR16(q4);
+	r5 = AES_BS_ROTR16(q5);
+	r6 = AES_BS_ROTR16(q6);
+	r7 = AES_BS_ROTR16(q7);
+
+	q[0] = q7 ^ r7 ^ r0 ^ AES_BS_ROTR32(q0 ^ r0);
+	q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ AES_BS_ROTR32(q1 ^ r1);
+	q[2] = q1 ^ r1 ^ r2 ^ AES_BS_ROTR32(q2 ^ r2);
+	q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ AES_BS_ROTR32(q3 ^ r3);
+	q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ AES_BS_ROTR32(q4 ^ r4);
+	q[5] = q4 ^ r4 ^ r5 ^ AES_BS_ROTR32(q5 ^ r5);
+	q[6] = q5 ^ r5 ^ r6 ^ AES_BS_ROTR32(q6 ^ r6);
+	q[7] = q6 ^ r6 ^ r7 ^ AES_BS_ROTR32(q7 ^ r7);
+}
+
+static void aes_bs_add_round_key(aes_bs_word *q, const uint64_t *sk)
+{
+	unsigned int i;
+
+	for(i = 0; i < 8; i++){
+		q[i] ^= sk[i];
+	}
+}
+
+/* The round keys as bit planes (the same in both lanes), from ctx->rk */
+static void aes_bs_expand_round_keys(aes_core_context *ctx)
+{
+	aes_bs_word q[8];
+	uint32_t w[4 * AES_BS_BLOCKS];
+	uint64_t pair[2];
+	unsigned int r, i;
+
+	for(r = 0; r <= ctx->nr; r++){
+		for(i = 0; i < AES_BS_BLOCKS; i++){
+			memcpy(&w[4 * i], &ctx->rk[4 * r], 16);
+		}
+		aes_bs_load(q, w);
+		for(i = 0; i < 8; i++){
+			memcpy(pair, &q[i], sizeof(pair));
+			ctx->bs_rk[(8 * r) + i] = pair[0];
+		}
+	}
+	memset(w, 0, sizeof(w));
+	memset(pair, 0, sizeof(pair));
+	memset(q, 0, sizeof(q));
+	ctx->bs_ready = 1;
+}
+
+int aes_bs_setkey_enc(aes_core_context *ctx, const uint8_t *key, uint32_t keybits)
+{
+	static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+	uint32_t i, j, k, nk, nkf, tmp;
+	int ret = -1;
+
+	if((ctx == NULL) || (key == NULL)){
+		goto err;
+	}
+	if((keybits != 128) && (keybits != 192) && (keybits != 256)){
+		goto err;
+	}
+	ctx->nr = (keybits / 32) + 6;
+	nk = keybits / 32;
+	nkf = 4 * (ctx->nr + 1);
+
+	for(i = 0; i < nk; i++){
+		ctx->rk[i] = (uint32_t)key[4 * i] | ((uint32_t)key[(4 * i) + 1] << 8) |
+			((uint32_t)key[(4 * i) + 2] << 16) | ((uint32_t)key[(4 * i) + 3] << 24);
+	}
+	tmp = ctx->rk[nk - 1];
+	for(i = nk, j = 0, k = 0; i < nkf; i++){
+		if(j == 0){
+			tmp = (tmp << 24) | (tmp >> 8);
+			tmp = aes_bs_sub_word(tmp) ^ rcon[k];
+		}
+		else if((nk > 6) && (j == 4)){
+			tmp = aes_bs_sub_word(tmp);
+		}
+		tmp ^= ctx->rk[i - nk];
+		ctx->rk[i] = tmp;
+		if(++j == nk){
+			j = 0;
+			k++;
+		}
+	}
+	tmp = 0;
+	aes_bs_expand_round_keys(ctx);
+
+	ret = 0;
+
+err:
+	return ret;
+}
+
+void aes_bs_enc_blocks(aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks)
+{
+	aes_bs_word q[8];
+	uint32_t w[4 * AES_BS_BLOCKS];
+	uint32_t i, u, n;
+
+	if(!ctx->bs_ready){
+		aes_bs_expand_round_keys(ctx);
+	}
+	while(nblocks > 0){
+		/* A short last batch is completed with zeros */
+		n = (nblocks < AES_BS_BLOCKS) ? nblocks : AES_BS_BLOCKS;
+		memset(w, 0, sizeof(w));
+		for(i = 0; i < 4 * n; i++){
+			w[i] = (uint32_t)data_in[4 * i] | ((uint32_t)data_in[(4 * i) + 1] << 8) |
+				((uint32_t)data_in[(4 * i) + 2] << 16) | ((uint32_t)data_in[(4 * i) + 3] << 24);
+		}
+		aes_bs_load(q, w);
+
+		aes_bs_add_round_key(q, &ctx->bs_rk[0]);
+		for(u = 1; u < ctx->nr; u++){
+			aes_bs_sbox(q);
+			aes_bs_shift_rows(q);
+			aes_bs_mix_columns(q);
+			aes_bs_add_round_key(q, &ctx->bs_rk[8 * u]);
+		}
+		aes_bs_sbox(q);
+		aes_bs_shift_rows(q);
+		aes_bs_add_round_key(q, &ctx->bs_rk[8 * ctx->nr]);
+
+		aes_bs_store(w, q);
+		for(i = 0; i < 4 * n; i++){
+			data_out[4 * i] = (uint8_t)w[i];
+			data_out[(4 * i) + 1] = (uint8_t)(w[i] >> 8);
+			data_out[(4 * i) + 2] = (uint8_t)(w[i] >> 16);
+			data_out[(4 * i) + 3] = (uint8_t)(w[i] >> 24);
+		}
+		data_in += 16 * n;
+		data_out += 16 * n;
+		nblocks -= n;
+	}
+	memset(w, 0, sizeof(w));
+	memset(q, 0, sizeof(q));
+}
+
+#else /* !WITH_AES_BITSLICE */
+/*
+ * Dummy definition to avoid the empty translation unit ISO C warning
+ */
+typedef int dummy;
+#endif /* WITH_AES_BITSLICE */
@@ -0,0 +1,34 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifdef WITH_BC_AES
+
+#ifndef __AES_BS_H__
+#define __AES_BS_H__
+
+#include "aes.h"
+
+#ifdef WITH_AES_BITSLICE
+/*
+ * Constant time bitsliced AES: 8 blocks go through the rounds at once, as
+ * 8 bit planes of 2 x 64 bits (SSE2 on x86, NEON on ARM). No table is
+ * indexed by secret data, neither in the key schedule nor in encryption.
+ */
+
+/* Key schedule in the representation of TABLE_AES (ctx->rk and ctx->nr) */
+int aes_bs_setkey_enc(aes_core_context *ctx, const uint8_t *key, uint32_t keybits);
+
+/* Encrypt nblocks independent blocks (in place or not) */
+void aes_bs_enc_blocks(aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks);
+#endif
+
+#endif /* __AES_BS_H__ */
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifdef WITH_BC_AES
+#include "aes_hw.h"
+#endif
+
+#ifdef WITH_AES_HW
+
+/* Detection state: -1 not done yet, then 0 or 1 */
+static int aes_hw_state = -1;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+/* Unaligned 16 bytes load */
+#define AES_HW_LOAD(p)	_mm_loadu_si128((const __m128i*)(const void*)(p))
+
+static int aes_hw_detect(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+		return 0;
+	}
+	return ((ecx & bit_AES) != 0) && ((edx & bit_SSE2) != 0);
+}
+
+__attribute__((target("aes,sse2")))
+void aes_hw_enc(const aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[16])
+{
+	const uint8_t *rk = (const uint8_t*)ctx->rk;
+	__m128i state;
+	uint32_t i;
+
+	state = _mm_xor_si128(AES_HW_LOAD(data_in), AES_HW_LOAD(&rk[0]));
+	for(i = 1; i < ctx->nr; i++){
+		state = _mm_aesenc_si128(state, AES_HW_LOAD(&rk[16 * i]));
+	}
+	state = _mm_aesenclast_si128(state, AES_HW_LOAD(&rk[16 * ctx->nr]));
+	_mm_storeu_si128((__m128i*)(void*)data_out, state);
+}
+
+__attribute__((target("aes,sse2")))
+void aes_hw_enc_blocks(const aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks)
+{
+	const uint8_t *rk = (const uint8_t*)ctx->rk;
+	__m128i state[AES_HW_LANES], k;
+	uint32_t i, j;
+
+	for(; nblocks >= AES_HW_LANES; nblocks -= AES_HW_LANES){
+		/* The rounds of the lanes are independent and overlap in the pipeline */
+		k = AES_HW_LOAD(&rk[0]);
+		for(j = 0; j < AES_HW_LANES; j++){
+			state[j] = _mm_xor_si128(AES_HW_LOAD(&data_in[16 * j]), k);
+		}
+		for(i = 1; i < ctx->nr; i++){
+			k = AES_HW_LOAD(&rk[16 * i]);
+			for(j = 0; j < AES_HW_LANES; j++){
+				state[j] = _mm_aesenc_si128(state[j], k);
+			}
+		}
+		k = AES_HW_LOAD(&rk[16 * ctx->nr]);
+		for(j = 0; j < AES_HW_LANES; j++){
+			_mm_storeu_si128((__m128i*)(void*)&data_out[16 * j], _mm_aesenclast_si128(state[j], k));
+		}
+		data_in += 16 * AES_HW_LANES;
+		data_out += 16 * AES_HW_LANES;
+	}
+	for(; nblocks > 0; nblocks--){
+		aes_hw_enc(ctx, data_in, data_out);
+		data_in += 16;
+		data_out += 16;
+	}
+}
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_neon.h>
+
+#ifdef __clang__
+#define AES_HW_TARGET	__attribute__((target("aes")))
+#else
+#define AES_HW_TARGET	__attribute__((target("+crypto")))
+#endif
+
+static int aes_hw_detect(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+}
+
+AES_HW_TARGET
+void aes_hw_enc(const aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[16])
+{
+	const uint8_t *rk = (const uint8_t*)ctx->rk;
+	uint8x16_t state;
+	uint32_t i;
+
+	/* AESE is AddRoundKey, SubBytes and ShiftRows; AESMC is MixColumns */
+	state = vld1q_u8(data_in);
+	for(i = 0; i < (ctx->nr - 1); i++){
+		state = vaesmcq_u8(vaeseq_u8(state, vld1q_u8(&rk[16 * i])));
+	}
+	state = vaeseq_u8(state, vld1q_u8(&rk[16 * (ctx->nr - 1)]));
+	state = veorq_u8(state, vld1q_u8(&rk[16 * ctx->nr]));
+	vst1q_u8(data_out, state);
+}
+
+AES_HW_TARGET
+void aes_hw_enc_blocks(const aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks)
+{
+	const uint8_t *rk = (const uint8_t*)ctx->rk;
+	uint8x16_t state[AES_HW_LANES], k;
+	uint32_t i, j;
+
+	for(; nblocks >= AES_HW_LANES; nblocks -= AES_HW_LANES){
+		/* The rounds of the lanes are independent and overlap in the pipeline */
+		for(j = 0; j < AES_HW_LANES; j++){
+			state[j] = vld1q_u8(&data_in[16 * j]);
+		}
+		for(i = 0; i < (ctx->nr - 1); i++){
+			k = vld1q_u8(&rk[16 * i]);
+			for(j = 0; j < AES_HW_LANES; j++){
+				state[j] = vaesmcq_u8(vaeseq_u8(state[j], k));
+			}
+		}
+		k = vld1q_u8(&rk[16 * (ctx->nr - 1)]);
+		for(j = 0; j < AES_HW_LANES; j++){
+			state[j] = vaeseq_u8(state[j], k);
+		}
+		k = vld1q_u8(&rk[16 * ctx->nr]);
+		for(j = 0; j < AES_HW_LANES; j++){
+			vst1q_u8(&data_out[16 * j], veorq_u8(state[j], k));
+		}
+		data_in += 16 * AES_HW_LANES;
+		data_out += 16 * AES_HW_LANES;
+	}
+	for(; nblocks > 0; nblocks--){
+		aes_hw_enc(ctx, data_in, data_out);
+		data_in += 16;
+		data_out += 16;
+	}
+}
+#endif
+
+int aes_hw_available(void)
+{
+	int state = __atomic_load_n(&aes_hw_state, __ATOMIC_RELAXED);
+
+	if(state < 0){
+		state = aes_hw_detect();
+		__atomic_store_n(&aes_hw_state, state, __ATOMIC_RELAXED);
+	}
+	return state;
+}
+
+#else /* !WITH_AES_HW */
+/*
+ * Dummy definition to avoid the empty translation unit ISO C warning
+ */
+typedef int dummy;
+#endif /* WITH_AES_HW */
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifdef WITH_BC_AES
+
+#ifndef __AES_HW_H__
+#define __AES_HW_H__
+
+#include "aes.h"
+
+/*
+ * Hardware AES encryption (AES-NI on x86, Crypto Extensions on AArch64),
+ * used by aes_enc() when the CPU supports it. The round keys come from the
+ * portable key schedule: on little endian CPUs, both the TABLE_AES and the
+ * SIMPLE_AES round keys are laid out in memory as the standard byte string
+ * the instructions expect. Define NO_AES_HW to only use the portable code.
+ */
+#if !defined(NO_AES_HW) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__) || \
+     (defined(__aarch64__) && defined(__linux__) && !defined(__AARCH64EB__)))
+#define WITH_AES_HW
+
+/* Non zero if the CPU has the AES instructions (detected once) */
+int aes_hw_available(void);
+
+/* Encrypt one block with the round keys of ctx */
+void aes_hw_enc(const aes_core_context *ctx, const uint8_t data_in[16], uint8_t data_out[16]);
+
+/* Encrypt nblocks independent blocks, AES_HW_LANES at a time through the pipeline */
+#define AES_HW_LANES	8
+void aes_hw_enc_blocks(const aes_core_context *ctx, const uint8_t *data_in, uint8_t *data_out, uint32_t nblocks);
+#endif
+
+#endif /* __AES_HW_H__ */
+
+#endif
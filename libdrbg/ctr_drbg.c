@@ -64,6 +64,19 @@ static inline void ctr_drbg_integer_inc(const uint8_t *A, uint8_t *C,
 	return;
 }
 
+/* V = (leftmost(V, blocklen - ctr_len) || (rightmost(V, ctr_len) + 1) mod 2^ctr_len) */
+static inline void ctr_drbg_ctr_inc(uint8_t *V, uint32_t block_len, uint32_t ctr_len)
+{
+	if(ctr_len < block_len){
+		ctr_drbg_integer_inc(&(V[block_len - ctr_len]), &(V[block_len - ctr_len]), ctr_len);
+	}
+	else{
+		ctr_drbg_integer_inc(V, V, block_len);
+	}
+
+	return;
+}
+
 #ifdef WITH_BC_TDEA
 /* Compute the TDEA keys with zero parity bits.
  * This allow to transform the 56 raw bits into 64 bits
@@ -103,10 +116,9 @@ static void des_compute_key(const uint8_t *K, uint8_t *K_)
 }
 #endif
 
-/* The Block_Encrypt function */
-static drbg_error ctr_drbg_block_encrypt(drbg_ctx *ctx,
-					 const uint8_t *K, const uint8_t *B,
-					 uint8_t *B_out)
+/* Expand the block cipher key K */
+static drbg_error ctr_drbg_block_setkey(drbg_ctx *ctx,
+					const uint8_t *K, ctr_drbg_bc_key *ks)
 {
 	drbg_error ret = CTR_DRBG_ERROR;
 	block_cipher_type bc_type;
@@ -114,20 +126,14 @@ static drbg_error ctr_drbg_block_encrypt(drbg_ctx *ctx,
 
 #if !defined(WITH_BC_TDEA) && !defined(WITH_BC_AES)
 	/* Avoid unused variables */
-	(void)ctx;
 	(void)K;
-	(void)B;
-	(void)B_out;
+	(void)ks;
 #endif
 
 	if(ctx == NULL){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
 		goto err;
 	}
-	if(ctr_drbg_check_initialized(ctx) != CTR_DRBG_OK){
-		ret = CTR_DRBG_NON_INIT;
-		goto err;
-	}
 
 	/* Access specific data */
 	bc_type = DRBG_CTR_GET_DATA(ctx, bc_type);
@@ -136,17 +142,60 @@ static drbg_error ctr_drbg_block_encrypt(drbg_ctx *ctx,
 	switch(bc_type){
 #ifdef WITH_BC_TDEA
 		case CTR_DRBG_BC_TDEA:{
-			des3_context des3_ctx;
 			uint8_t K1[8], K2[8], K3[8];
 			/* Compute and set TDEA keys parity bits */
 			des_compute_key(&K[0],  K1);
 			des_compute_key(&K[7],  K2);
 			des_compute_key(&K[14], K3);
-			if(des3_set_keys(&des3_ctx, K1, K2, K3, DES_ENCRYPTION)){
+			if(des3_set_keys(&ks->tdea, K1, K2, K3, DES_ENCRYPTION)){
 				ret = CTR_DRBG_ERROR;
 				goto err;
 			}
-			if(des3(&des3_ctx, B, B_out)){
+			break;
+		}
+#endif
+#ifdef WITH_BC_AES
+		case CTR_DRBG_BC_AES128:
+		case CTR_DRBG_BC_AES192:
+		case CTR_DRBG_BC_AES256:{
+			if(aes_setkey_enc(&ks->aes, K, (8 * key_len))){
+				ret = CTR_DRBG_ERROR;
+				goto err;
+			}
+			break;
+		}
+#endif
+		default:{
+			/* Avoid unused variable in conditional compilation */
+			(void)key_len;
+			ret = CTR_DRBG_ERROR;
+			goto err;
+		}
+	}
+
+	ret = CTR_DRBG_OK;
+err:
+	return ret;
+}
+
+/* The Block_Encrypt function, with an expanded key */
+static drbg_error ctr_drbg_block_encrypt_ks(drbg_ctx *ctx,
+					    ctr_drbg_bc_key *ks, const uint8_t *B,
+					    uint8_t *B_out)
+{
+	drbg_error ret = CTR_DRBG_ERROR;
+
+#if !defined(WITH_BC_TDEA) && !defined(WITH_BC_AES)
+	/* Avoid unused variables */
+	(void)ks;
+	(void)B;
+	(void)B_out;
+#endif
+
+	switch(DRBG_CTR_GET_DATA(ctx, bc_type)){
+#ifdef WITH_BC_TDEA
+		case CTR_DRBG_BC_TDEA:{
+			if(des3(&ks->tdea, B, B_out)){
 				ret = CTR_DRBG_ERROR;
 				goto err;
 			}
@@ -157,12 +206,38 @@ static drbg_error ctr_drbg_block_encrypt(drbg_ctx *ctx,
 		case CTR_DRBG_BC_AES128:
 		case CTR_DRBG_BC_AES192:
 		case CTR_DRBG_BC_AES256:{
-			aes_core_context aes_ctx;
-			if(aes_setkey_enc(&aes_ctx, K, (8 * key_len))){
+			if(aes_enc(&ks->aes, B, B_out)){
 				ret = CTR_DRBG_ERROR;
 				goto err;
 			}
-			if(aes_enc(&aes_ctx, B, B_out)){
+			break;
+		}
+#endif
+		default:{
+			ret = CTR_DRBG_ERROR;
+			goto err;
+		}
+	}
+
+	ret = CTR_DRBG_OK;
+err:
+	return ret;
+}
+
+/* Block_Encrypt of nblocks independent blocks, with an expanded key */
+static drbg_error ctr_drbg_blocks_encrypt_ks(drbg_ctx *ctx,
+					     ctr_drbg_bc_key *ks, const uint8_t *B,
+					     uint8_t *B_out, uint32_t nblocks)
+{
+	drbg_error ret = CTR_DRBG_ERROR;
+	uint32_t i, block_len;
+
+	switch(DRBG_CTR_GET_DATA(ctx, bc_type)){
+#ifdef WITH_BC_AES
+		case CTR_DRBG_BC_AES128:
+		case CTR_DRBG_BC_AES192:
+		case CTR_DRBG_BC_AES256:{
+			if(aes_enc_blocks(&ks->aes, B, B_out, nblocks)){
 				ret = CTR_DRBG_ERROR;
 				goto err;
 			}
@@ -170,10 +245,14 @@ static drbg_error ctr_drbg_block_encrypt(drbg_ctx *ctx,
 		}
 #endif
 		default:{
-			/* Avoid unused variable in conditional compilation */
-			(void)key_len;
-			ret = CTR_DRBG_ERROR;
-			goto err;
+			block_len = DRBG_CTR_GET_DATA(ctx, block_len);
+			for(i = 0; i < nblocks; i++){
+				if((ret = ctr_drbg_block_encrypt_ks(ctx, ks, &B[i * block_len],
+								    &B_out[i * block_len])) != CTR_DRBG_OK){
+					goto err;
+				}
+			}
+			break;
 		}
 	}
 
@@ -182,15 +261,28 @@ err:
 	return ret;
 }
 
-/* The BCC function */
+/* Rebuild the expanded key after Key changed */
+static drbg_error ctr_drbg_set_key(drbg_ctx *ctx)
+{
+	return ctr_drbg_block_setkey(ctx, DRBG_CTR_GET_DATA(ctx, Key),
+				     &DRBG_CTR_GET_DATA(ctx, key_sched));
+}
+
+/*
+ * The BCC function, with an expanded key, for nchains chains at once.
+ * Each chain starts with its own first block, given in chains, and then
+ * takes the same scattered data: the chains of the DF only differ by their
+ * IV, so that they go through the block cipher together.
+ */
 static drbg_error ctr_drbg_bcc(drbg_ctx *ctx,
-				   const uint8_t *K,
+				   ctr_drbg_bc_key *ks,
 				   const in_scatter_data *sc, unsigned int sc_num,
-				   uint8_t *output_block)
+				   uint8_t *chains, uint32_t nchains)
 {
 	drbg_error ret = CTR_DRBG_ERROR;
-	uint32_t data_len, i, block_len, cur_sc = 0, cur_sc_offset = 0, sc_remain;
-	uint8_t block[CTR_DRBG_MAX_BLOCK_LEN] = { 0 };
+	uint32_t data_len, i, j, c, block_len, cur_sc = 0, cur_sc_offset = 0, sc_remain;
+	uint32_t needed, copied, local_offset;
+	const uint8_t *data;
 
 	if(ctx == NULL){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
@@ -214,14 +306,14 @@ static drbg_error ctr_drbg_bcc(drbg_ctx *ctx,
 		goto err;
 	}
 
-	/* Set chaining value to 0 */
-	memset(output_block, 0, block_len);
+	/* First block, with a zero chaining value */
+	if((ret = ctr_drbg_blocks_encrypt_ks(ctx, ks, chains, chains, nchains)) != CTR_DRBG_OK){
+		goto err;
+	}
 
 	for (i = 0; i < (data_len / block_len); i++) {
-		uint32_t needed, copied, local_offset = 0;
-		unsigned int j;
-
-		/* Copy data from scattered input to our block */
+		/* XOR the next block of the scattered input into the chaining values */
+		local_offset = 0;
 		while (local_offset < block_len) {
 			sc_remain = sc[cur_sc].data_len - cur_sc_offset;
 			if (!sc_remain) {
@@ -233,16 +325,17 @@ static drbg_error ctr_drbg_bcc(drbg_ctx *ctx,
 
 			needed = (block_len - local_offset);
 			copied = (needed < sc_remain) ? needed : sc_remain;
-			memcpy(block+local_offset, sc[cur_sc].data+cur_sc_offset, copied);
+			data = &sc[cur_sc].data[cur_sc_offset];
+			for(c = 0; c < nchains; c++){
+				for(j = 0; j < copied; j++){
+					chains[(c * block_len) + local_offset + j] ^= data[j];
+				}
+			}
 			local_offset += copied;
 			cur_sc_offset += copied;
 		}
 
-		for(j = 0; j < block_len; j++){
-			output_block[j] ^= block[j];
-		}
-
-		if((ret = ctr_drbg_block_encrypt(ctx, K, output_block, output_block)) != CTR_DRBG_OK){
+		if((ret = ctr_drbg_blocks_encrypt_ks(ctx, ks, chains, chains, nchains)) != CTR_DRBG_OK){
 			goto err;
 		}
 	}
@@ -265,15 +358,15 @@ static drbg_error ctr_drbg_block_cipher_df(drbg_ctx *ctx,
 {
 	drbg_error ret = CTR_DRBG_ERROR;
 	uint32_t block_len, key_len;
-	uint32_t i, input_string_len, pad_len;
+	uint32_t i, nchains, input_string_len, pad_len;
 	in_scatter_data sc_data[MAX_SCATTER_DATA] = { { .data = NULL, .data_len = 0 } };
 
 	uint8_t temp[CTR_DRBG_MAX_KEY_LEN + CTR_DRBG_MAX_BLOCK_LEN] = { 0 };
 	uint8_t L[4] = { 0 }, N[4] = { 0 };
 	uint8_t P[1] = { 0x80 };
 	uint8_t K[CTR_DRBG_MAX_KEY_LEN] = { 0 };
-	uint8_t IV[CTR_DRBG_MAX_BLOCK_LEN] = { 0 };
 	uint8_t X[CTR_DRBG_MAX_BLOCK_LEN] = { 0 };
+	ctr_drbg_bc_key ks;
 
 	if(ctx == NULL){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
@@ -284,7 +377,7 @@ static drbg_error ctr_drbg_block_cipher_df(drbg_ctx *ctx,
 		goto err;
 	}
 	/* Sanity check on scatted data overflow */
-	if((sc_num + 5) > MAX_SCATTER_DATA){
+	if((sc_num + 4) > MAX_SCATTER_DATA){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
 		goto err;
 	}
@@ -305,56 +398,58 @@ static drbg_error ctr_drbg_block_cipher_df(drbg_ctx *ctx,
 		input_string_len += sc[i].data_len;
 	}
 
-	/* Forge IV || S */
+	/* Forge S (the IV of each chain is given to BCC apart) */
 	PUT_UINT32_BE(input_string_len, L, 0);
 	PUT_UINT32_BE(output_len, N, 0);
 
-	sc_data[0].data = IV;
-	sc_data[0].data_len = block_len;
-	sc_data[1].data = L;
+	sc_data[0].data = L;
+	sc_data[0].data_len = 4;
+	sc_data[1].data = N;
 	sc_data[1].data_len = 4;
-	sc_data[2].data = N;
-	sc_data[2].data_len = 4;
 	for(i = 0; i < sc_num; i++){
-		sc_data[3 + i].data = sc[i].data;
-		sc_data[3 + i].data_len = sc[i].data_len;
+		sc_data[2 + i].data = sc[i].data;
+		sc_data[2 + i].data_len = sc[i].data_len;
 	}
-	sc_data[3 + sc_num].data = P;
-	sc_data[3 + sc_num].data_len = 1;
+	sc_data[2 + sc_num].data = P;
+	sc_data[2 + sc_num].data_len = 1;
 	/* Dealing with the padding */
-	sc_data[4 + sc_num].data = X;
+	sc_data[3 + sc_num].data = X;
 	pad_len = ((4 + 4 + input_string_len + 1) % block_len);
 	pad_len = (pad_len == 0) ? 0 : (block_len - pad_len);
-	sc_data[4 + sc_num].data_len = pad_len;
+	sc_data[3 + sc_num].data_len = pad_len;
 
-	for(i = 0; i < key_len; i++){
-		K[i] = (uint8_t)i;
+	/* BCC with the constant key 0x00 0x01 ..., expanded once at init, of
+	 * IV || S for the IVs 0, 1, ... (the counter padded with zeros)
+	 */
+	nchains = 0;
+	for(i = 0; i < (key_len + block_len); i += block_len){
+		PUT_UINT32_BE(nchains, temp, i);
+		nchains++;
 	}
-	i = 0;
-	while(i < (key_len + block_len)){
-		PUT_UINT32_BE((i / block_len), IV, 0);
-		if((ret = ctr_drbg_bcc(ctx, K, sc_data,
-				       (5 + sc_num), &temp[i])) != CTR_DRBG_OK){
-			goto err;
-		}
-		i += block_len;
+	if((ret = ctr_drbg_bcc(ctx, &DRBG_CTR_GET_DATA(ctx, df_key_sched), sc_data,
+			       (4 + sc_num), temp, nchains)) != CTR_DRBG_OK){
+		goto err;
 	}
 	memcpy(K, &temp[0], key_len);
 	memcpy(X, &temp[key_len], block_len);
 
+	/* Expand the new K once for the whole output chain */
+	if((ret = ctr_drbg_block_setkey(ctx, K, &ks)) != CTR_DRBG_OK){
+		goto err;
+	}
 	memset(temp, 0, sizeof(temp));
 	i = 0;
 	while(i < output_len){
 		if(i == 0){
-			if((ret = ctr_drbg_block_encrypt(ctx, K, X,
-							 &temp[0])) != CTR_DRBG_OK){
+			if((ret = ctr_drbg_block_encrypt_ks(ctx, &ks, X,
+							    &temp[0])) != CTR_DRBG_OK){
 				goto err;
 			}
 		}
 		else{
-			if((ret = ctr_drbg_block_encrypt(ctx, K,
-							 &temp[i - block_len],
-							 &temp[i])) != CTR_DRBG_OK){
+			if((ret = ctr_drbg_block_encrypt_ks(ctx, &ks,
+							    &temp[i - block_len],
+							    &temp[i])) != CTR_DRBG_OK){
 				goto err;
 			}
 		}
@@ -364,6 +459,11 @@ static drbg_error ctr_drbg_block_cipher_df(drbg_ctx *ctx,
 
 	ret = CTR_DRBG_OK;
 err:
+	/* Cleanup local stack */
+	memset(&ks, 0, sizeof(ks));
+	memset(K, 0, sizeof(K));
+	memset(temp, 0, sizeof(temp));
+
 	return ret;
 }
 
@@ -379,6 +479,7 @@ static drbg_error ctr_drbg_update(drbg_ctx *ctx,
 	uint32_t seed_len;
 	unsigned int i;
 	uint8_t *V, *Key;
+	ctr_drbg_bc_key *key_sched;
 
 	if(ctx == NULL){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
@@ -396,6 +497,7 @@ static drbg_error ctr_drbg_update(drbg_ctx *ctx,
 	seed_len  = DRBG_CTR_GET_DATA(ctx, seed_len);
 	V         = DRBG_CTR_GET_DATA(ctx, V);
 	Key       = DRBG_CTR_GET_DATA(ctx, Key);
+	key_sched = &DRBG_CTR_GET_DATA(ctx, key_sched);
 
 	/* Sanity check on length */
 	if(provided_data_len != seed_len){
@@ -403,29 +505,31 @@ static drbg_error ctr_drbg_update(drbg_ctx *ctx,
 		goto err;
 	}
 
+	/* The counter blocks are independent: encrypt them in one batch */
 	temp_len = 0;
 	while(temp_len < seed_len){
-		if(ctr_len < block_len){
-			ctr_drbg_integer_inc(&(V[block_len - ctr_len]),
-					     &(V[block_len - ctr_len]), ctr_len);
-		}
-		else{
-			ctr_drbg_integer_inc(V, V, block_len);
-		}
-		if((ret = ctr_drbg_block_encrypt(ctx, Key, V,
-						 &temp[temp_len])) != CTR_DRBG_OK){
-			goto err;
-		}
+		ctr_drbg_ctr_inc(V, block_len, ctr_len);
+		memcpy(&temp[temp_len], V, block_len);
 		temp_len += block_len;
 	}
+	if((ret = ctr_drbg_blocks_encrypt_ks(ctx, key_sched, temp, temp,
+					     temp_len / block_len)) != CTR_DRBG_OK){
+		goto err;
+	}
 	for(i = 0; i < seed_len; i++){
 		temp[i] ^= provided_data[i];
 	}
 	memcpy(Key, temp, key_len);
 	memcpy(V, &temp[key_len], block_len);
+	if((ret = ctr_drbg_set_key(ctx)) != CTR_DRBG_OK){
+		goto err;
+	}
 
 	ret = CTR_DRBG_OK;
 err:
+	/* Cleanup local stack */
+	memset(temp, 0, sizeof(temp));
+
 	return ret;
 }
 
@@ -609,6 +713,21 @@ static drbg_error ctr_drbg_init(drbg_ctx *ctx,
 	/* Zeroize values */
 	memset(Key, 0, DRBG_CTR_KEY_SIZE);
 	memset(V, 0, DRBG_CTR_V_SIZE);
+	memset(&DRBG_CTR_GET_DATA(ctx, key_sched), 0, sizeof(ctr_drbg_bc_key));
+	/* The DF always uses the same key: expand it once here */
+	memset(&DRBG_CTR_GET_DATA(ctx, df_key_sched), 0, sizeof(ctr_drbg_bc_key));
+	if(use_df == true){
+		uint8_t df_key[CTR_DRBG_MAX_KEY_LEN];
+		uint32_t i;
+
+		for(i = 0; i < sizeof(df_key); i++){
+			df_key[i] = (uint8_t)i;
+		}
+		if((ret = ctr_drbg_block_setkey(ctx, df_key,
+						&DRBG_CTR_GET_DATA(ctx, df_key_sched))) != CTR_DRBG_OK){
+			goto err;
+		}
+	}
 	ctx->reseed_counter = 0;
 
 	ctx->engine_is_instantiated = false;
@@ -894,6 +1013,9 @@ drbg_error ctr_drbg_instantiate(drbg_ctx *ctx,
 
 	memset(Key, 0, DRBG_CTR_KEY_SIZE);
 	memset(V, 0, DRBG_CTR_V_SIZE);
+	if((ret = ctr_drbg_set_key(ctx)) != CTR_DRBG_OK){
+		goto err;
+	}
 	if((ret = ctr_drbg_update(ctx, seed_material, seed_len)) != CTR_DRBG_OK){
 		goto err;
 	}
@@ -1005,7 +1127,8 @@ drbg_error ctr_drbg_generate(drbg_ctx *ctx,
 	uint32_t seed_len, ctr_len, block_len;
 	uint32_t i;
 	bool use_df;
-	uint8_t *V, *Key;
+	uint8_t *V;
+	ctr_drbg_bc_key *key_sched;
 
 	if(ctx == NULL){
 		ret = CTR_DRBG_ILLEGAL_INPUT;
@@ -1039,7 +1162,7 @@ drbg_error ctr_drbg_generate(drbg_ctx *ctx,
 	block_len = DRBG_CTR_GET_DATA(ctx, block_len);
 	use_df    = DRBG_CTR_GET_DATA(ctx, use_df);
 	V         = DRBG_CTR_GET_DATA(ctx, V);
-	Key       = DRBG_CTR_GET_DATA(ctx, Key);
+	key_sched = &DRBG_CTR_GET_DATA(ctx, key_sched);
 
 	if(ctx->reseed_counter < 1){
 		/* DRBG not seeded yet! */
@@ -1083,22 +1206,36 @@ drbg_error ctr_drbg_generate(drbg_ctx *ctx,
 		}
 	}
 
+	/*
+	 * Full blocks: a run of successive counter values is laid out in out and
+	 * encrypted in place, so that the block cipher can work on the blocks of
+	 * a batch at the same time.
+	 */
 	i = 0;
-	while(i < out_len){
-		uint8_t out_block[CTR_DRBG_MAX_BLOCK_LEN];
-		uint32_t to_copy;
-		if(ctr_len < block_len){
-			ctr_drbg_integer_inc(&(V[block_len - ctr_len]), &(V[block_len - ctr_len]), ctr_len);
+	while((out_len - i) >= block_len){
+		uint32_t j, nblocks = (out_len - i) / block_len;
+		if(nblocks > CTR_DRBG_BATCH_BLOCKS){
+			nblocks = CTR_DRBG_BATCH_BLOCKS;
 		}
-		else{
-			ctr_drbg_integer_inc(V, V, block_len);
+		for(j = 0; j < nblocks; j++){
+			ctr_drbg_ctr_inc(V, block_len, ctr_len);
+			memcpy(&out[i + (j * block_len)], V, block_len);
 		}
-		if((ret = ctr_drbg_block_encrypt(ctx, Key, V, out_block)) != CTR_DRBG_OK){
+		if((ret = ctr_drbg_blocks_encrypt_ks(ctx, key_sched, &out[i], &out[i],
+						     nblocks)) != CTR_DRBG_OK){
 			goto err;
 		}
-		to_copy = ((out_len - i) < block_len) ? (out_len - i) : block_len;
-		memcpy(&out[i], out_block, to_copy);
-		i += block_len;
+		i += (nblocks * block_len);
+	}
+	/* Last partial block */
+	if(i < out_len){
+		uint8_t out_block[CTR_DRBG_MAX_BLOCK_LEN];
+		ctr_drbg_ctr_inc(V, block_len, ctr_len);
+		if((ret = ctr_drbg_block_encrypt_ks(ctx, key_sched, V, out_block)) != CTR_DRBG_OK){
+			goto err;
+		}
+		memcpy(&out[i], out_block, (out_len - i));
+		memset(out_block, 0, sizeof(out_block));
 	}
 
 	if((ret = ctr_drbg_update(ctx, additional_input, seed_len)) != CTR_DRBG_OK){
@@ -1128,6 +1265,8 @@ drbg_error ctr_drbg_uninstantiate(drbg_ctx *ctx)
 	/* Cleanup stuff inside our state */
 	memset(Key, 0x00, DRBG_CTR_KEY_SIZE);
 	memset(V, 0x00, DRBG_CTR_V_SIZE);
+	memset(&DRBG_CTR_GET_DATA(ctx, key_sched), 0x00, sizeof(ctr_drbg_bc_key));
+	memset(&DRBG_CTR_GET_DATA(ctx, df_key_sched), 0x00, sizeof(ctr_drbg_bc_key));
 
 	DRBG_CTR_SET_DATA(ctx, key_len, 0);
 	DRBG_CTR_SET_DATA(ctx, block_len, 0);
@@ -191,6 +191,8 @@ typedef enum {
 #define CTR_DRBG_MAX_BLOCK_LEN   16
 /* Maximum seedlen is CTR_DRBG_MAX_KEY_LEN + CTR_DRBG_MAX_BLOCK_LEN */
 #define CTR_DRBG_MAX_SEED_LEN  (CTR_DRBG_MAX_KEY_LEN + CTR_DRBG_MAX_BLOCK_LEN)
+/* Output blocks encrypted together by generate */
+#define CTR_DRBG_BATCH_BLOCKS	32
 
 /* Maximum sizes in bytes, see NIST SP800-90A Table 3 */
 #define CTR_DRBG_MAX_ENTROPY_SIZE                               ((uint64_t)0x1 << 32)  /* 2**35 bits max, 2**32 bytes max */
@@ -207,6 +209,17 @@ typedef enum {
 
 #define CTR_DRBG_INIT_MAGIC     0x9834651251389320
 
+/* Expanded block cipher key (round keys) */
+typedef union {
+#ifdef WITH_BC_TDEA
+	des3_context tdea;
+#endif
+#ifdef WITH_BC_AES
+	aes_core_context aes;
+#endif
+	uint8_t raw[1];
+} ctr_drbg_bc_key;
+
 typedef struct {
 	block_cipher_type bc_type;
 	bool use_df;
@@ -216,6 +229,10 @@ typedef struct {
 	uint32_t block_len;
 	uint32_t ctr_len;
 	uint32_t seed_len;
+	/* Expansion of Key, rebuilt each time Key changes */
+	ctr_drbg_bc_key key_sched;
+	/* Expansion of the constant key of the DF (0x00 0x01 ...), set at init */
+	ctr_drbg_bc_key df_key_sched;
 } ctr_drbg_engine_data;
 #define DRBG_CTR_KEY_SIZE CTR_DRBG_MAX_KEY_LEN
 #define DRBG_CTR_V_SIZE CTR_DRBG_MAX_BLOCK_LEN
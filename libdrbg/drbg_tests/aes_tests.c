@@ -0,0 +1,145 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#include "aes_tests.h"
+
+#ifdef WITH_BC_AES
+
+#include <string.h>
+
+/* FIPS-197 appendix B and appendix C.1 to C.3 */
+static const uint8_t aes_b_key[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+static const uint8_t aes_b_pt[] = { 0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34 };
+static const uint8_t aes_b_ct[] = { 0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32 };
+
+static const uint8_t aes_c_key[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+};
+static const uint8_t aes_c_pt[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+static const uint8_t aes_c1_ct[] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+static const uint8_t aes_c2_ct[] = { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 };
+static const uint8_t aes_c3_ct[] = { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 };
+
+static const aes_self_test aes_tests[] = {
+	{ "FIPS-197 B (AES-128)", aes_b_key, 128, aes_b_pt, aes_b_ct },
+	{ "FIPS-197 C.1 (AES-128)", aes_c_key, 128, aes_c_pt, aes_c1_ct },
+	{ "FIPS-197 C.2 (AES-192)", aes_c_key, 192, aes_c_pt, aes_c2_ct },
+	{ "FIPS-197 C.3 (AES-256)", aes_c_key, 256, aes_c_pt, aes_c3_ct },
+};
+
+static const struct {
+	aes_impl impl;
+	const char *name;
+} aes_impls[] = {
+	{ AES_IMPL_PORTABLE, "portable" },
+	{ AES_IMPL_HW, "AES instructions" },
+	{ AES_IMPL_BITSLICE, "bitsliced" },
+};
+
+/*
+ * Enough blocks for several full batches of the pipelined and bitsliced
+ * code (4 or 8 blocks) and every possible remainder
+ */
+#define AES_TEST_BLOCKS	37
+
+static int aes_run_tests(const char *backend)
+{
+	aes_core_context ctx;
+	uint8_t in[AES_TEST_BLOCKS * AES_BLOCK_SIZE];
+	uint8_t ref[AES_TEST_BLOCKS * AES_BLOCK_SIZE];
+	uint8_t out[AES_TEST_BLOCKS * AES_BLOCK_SIZE];
+	uint32_t i, j, n;
+	int ret = -1;
+
+	for(i = 0; i < (sizeof(aes_tests) / sizeof(aes_tests[0])); i++){
+		/* Known answer, one block at a time and through the multiple blocks path */
+		if(aes_setkey_enc(&ctx, aes_tests[i].key, aes_tests[i].keybits) ||
+		   aes_enc(&ctx, aes_tests[i].pt, out) ||
+		   memcmp(out, aes_tests[i].ct, AES_BLOCK_SIZE) ||
+		   aes_enc_blocks(&ctx, aes_tests[i].pt, out, 1) ||
+		   memcmp(out, aes_tests[i].ct, AES_BLOCK_SIZE)){
+			printf("Error for AES (%s) encryption of %s\n", backend, aes_tests[i].name);
+			goto err;
+		}
+		if(aes_setkey_dec(&ctx, aes_tests[i].key, aes_tests[i].keybits) ||
+		   aes_dec(&ctx, aes_tests[i].ct, out) ||
+		   memcmp(out, aes_tests[i].pt, AES_BLOCK_SIZE)){
+			printf("Error for AES (%s) decryption of %s\n", backend, aes_tests[i].name);
+			goto err;
+		}
+
+		/* Multiple blocks, of every count up to AES_TEST_BLOCKS, against
+		 * the single block encryption (checked above)
+		 */
+		for(j = 0; j < sizeof(in); j++){
+			in[j] = (uint8_t)((j * 0x9d) ^ (j >> 4) ^ i);
+		}
+		if(aes_setkey_enc(&ctx, aes_tests[i].key, aes_tests[i].keybits)){
+			goto err;
+		}
+		for(j = 0; j < AES_TEST_BLOCKS; j++){
+			if(aes_enc(&ctx, &in[j * AES_BLOCK_SIZE], &ref[j * AES_BLOCK_SIZE])){
+				goto err;
+			}
+		}
+		for(n = 1; n <= AES_TEST_BLOCKS; n++){
+			memset(out, 0, sizeof(out));
+			if(aes_enc_blocks(&ctx, in, out, n) ||
+			   memcmp(out, ref, n * AES_BLOCK_SIZE)){
+				printf("Error for AES (%s) of %u blocks with the %s key\n", backend, n, aes_tests[i].name);
+				goto err;
+			}
+		}
+		/* In place */
+		memcpy(out, in, sizeof(out));
+		if(aes_enc_blocks(&ctx, out, out, AES_TEST_BLOCKS) ||
+		   memcmp(out, ref, sizeof(ref))){
+			printf("Error for AES (%s) in place with the %s key\n", backend, aes_tests[i].name);
+			goto err;
+		}
+	}
+	printf("\t=========== AES (%s) OK\n", backend);
+
+	ret = 0;
+err:
+	return ret;
+}
+
+int do_aes_self_tests(void)
+{
+	unsigned int i;
+	int ret = -1;
+
+	for(i = 0; i < (sizeof(aes_impls) / sizeof(aes_impls[0])); i++){
+		/* Not built in, or not supported by the CPU */
+		if(aes_set_impl(aes_impls[i].impl)){
+			printf("\t=========== AES (%s) not available\n", aes_impls[i].name);
+			continue;
+		}
+		if(aes_run_tests(aes_impls[i].name)){
+			goto err;
+		}
+	}
+	printf("[+] All tests for AES are OK! :-)\n");
+
+	ret = 0;
+err:
+	/* Back to the default choice */
+	aes_set_impl(AES_IMPL_AUTO);
+	return ret;
+}
+
+#else
+/*
+ * Dummy definition to avoid the empty translation unit ISO C warning
+ */
+typedef int dummy;
+#endif
@@ -0,0 +1,35 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifndef __AES_TESTS_H__
+#define __AES_TESTS_H__
+
+#ifdef WITH_BC_AES
+
+#include "aes.h"
+
+typedef struct {
+        const char *name;
+        const uint8_t *key;
+        uint32_t keybits;
+        /* Plaintext and expected ciphertext */
+        const uint8_t *pt;
+        const uint8_t *ct;
+} aes_self_test;
+
+#include <stdio.h>
+/* FIPS-197 known answers, and multiple blocks encryption checked block
+ * by block, for each AES implementation that is built and supported
+ */
+int do_aes_self_tests(void);
+
+#endif
+
+#endif /* __AES_TESTS_H__ */
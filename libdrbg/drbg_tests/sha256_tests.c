@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#include "sha256_tests.h"
+
+#if defined(WITH_HASH_SHA256) || defined(WITH_HASH_SHA224)
+
+#ifdef WITH_HASH_SHA224
+static const sha256_self_test sha224_tests[] = {
+	{ "empty string", "", "\xd1\x4a\x02\x8c\x2a\x3a\x2b\xc9\x47\x61\x02\xbb\x28\x82\x34\xc4\x15\xa2\xb0\x1f\x82\x8e\xa6\x2a\xc5\xb3\xe4\x2f" },
+	{ "abc", "abc", "\x23\x09\x7d\x22\x34\x05\xd8\x22\x86\x42\xa4\x77\xbd\xa2\x55\xb3\x2a\xad\xbc\xe4\xbd\xa0\xb3\xf7\xe3\x6c\x9d\xa7" },
+	{ "448 bits message", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "\x75\x38\x8b\x16\x51\x27\x76\xcc\x5d\xba\x5d\xa1\xfd\x89\x01\x50\xb0\xc6\x45\x5c\xb4\xf5\x8b\x19\x52\x52\x25\x25" },
+	{ "896 bits message", "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "\xc9\x7c\xa9\xa5\x59\x85\x0c\xe9\x7a\x04\xa9\x6d\xef\x6d\x99\xa9\xe0\xe0\xe2\xab\x14\xe6\xb8\xdf\x26\x5f\xc0\xb3" },
+	{ "one million 'a'", NULL, "\x20\x79\x46\x55\x98\x0c\x91\xd8\xbb\xb4\xc1\xea\x97\x61\x8a\x4b\xf0\x3f\x42\x58\x19\x48\xb2\xee\x4e\xe7\xad\x67" },
+};
+#endif
+
+#ifdef WITH_HASH_SHA256
+static const sha256_self_test sha256_tests[] = {
+	{ "empty string", "", "\xe3\xb0\xc4\x42\x98\xfc\x1c\x14\x9a\xfb\xf4\xc8\x99\x6f\xb9\x24\x27\xae\x41\xe4\x64\x9b\x93\x4c\xa4\x95\x99\x1b\x78\x52\xb8\x55" },
+	{ "abc", "abc", "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad" },
+	{ "448 bits message", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e\x60\x39\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19\xdb\x06\xc1" },
+	{ "896 bits message", "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "\xcf\x5b\x16\xa7\x78\xaf\x83\x80\x03\x6c\xe5\x9e\x7b\x04\x92\x37\x0b\x24\x9b\x11\xe8\xf0\x7a\x51\xaf\xac\x45\x03\x7a\xfe\xe9\xd1" },
+	{ "one million 'a'", NULL, "\xcd\xc7\x6e\x5c\x99\x14\xfb\x92\x81\xa1\xc7\xe2\x84\xd7\x3e\x67\xf1\x80\x9a\x48\xa4\x97\x20\x0e\x04\x6d\x39\xcc\xc7\x11\x2c\xd0" },
+};
+#endif
+
+#define MILLION_A_CHUNK 1000
+
+/*
+ * Hash the message of a test through init/update/final, with chunks of
+ * growing sizes so that both the partial and the full blocks paths run
+ */
+#define SHA2_TEST_HASH(alg, msg, out, ret) do {						\
+	alg##_context ctx_;								\
+	uint8_t chunk_[MILLION_A_CHUNK];						\
+	uint32_t len_, off_, n_, i_;							\
+	(ret) = alg##_init(&ctx_);							\
+	if((msg) == NULL){								\
+		memset(chunk_, 'a', sizeof(chunk_));					\
+		for(i_ = 0; ((ret) == 0) && (i_ < (1000000 / MILLION_A_CHUNK)); i_++){	\
+			(ret) = alg##_update(&ctx_, chunk_, sizeof(chunk_));		\
+		}									\
+	}										\
+	else{										\
+		len_ = (uint32_t)strlen(msg);						\
+		for(off_ = 0, n_ = 1; ((ret) == 0) && (off_ < len_); off_ += n_, n_++){	\
+			n_ = ((len_ - off_) < n_) ? (len_ - off_) : n_;			\
+			(ret) = alg##_update(&ctx_, (const uint8_t*)&(msg)[off_], n_);	\
+		}									\
+	}										\
+	if((ret) == 0){									\
+		(ret) = alg##_final(&ctx_, (out));					\
+	}										\
+} while(0)
+
+static int sha256_run_tests(const char *backend)
+{
+	uint8_t out[SHA256_DIGEST_SIZE];
+	unsigned int i;
+	int ret;
+
+#ifdef WITH_HASH_SHA224
+	for(i = 0; i < (sizeof(sha224_tests) / sizeof(sha224_tests[0])); i++){
+		SHA2_TEST_HASH(sha224, sha224_tests[i].msg, out, ret);
+		if(ret || memcmp(out, sha224_tests[i].digest, SHA224_DIGEST_SIZE)){
+			printf("Error for SHA-224 (%s) of %s\n", backend, sha224_tests[i].name);
+			goto err;
+		}
+	}
+#endif
+#ifdef WITH_HASH_SHA256
+	for(i = 0; i < (sizeof(sha256_tests) / sizeof(sha256_tests[0])); i++){
+		SHA2_TEST_HASH(sha256, sha256_tests[i].msg, out, ret);
+		if(ret || memcmp(out, sha256_tests[i].digest, SHA256_DIGEST_SIZE)){
+			printf("Error for SHA-256 (%s) of %s\n", backend, sha256_tests[i].name);
+			goto err;
+		}
+	}
+#endif
+	printf("\t=========== SHA-224/SHA-256 (%s) OK\n", backend);
+
+	return 0;
+err:
+	return -1;
+}
+
+int do_sha256_self_tests(void)
+{
+	int ret = -1;
+
+#ifdef WITH_SHA256_HW
+	if(sha256_hw_available()){
+		if(sha256_hw_select(1) || sha256_run_tests("SHA instructions")){
+			goto err;
+		}
+	}
+	/* Then the scalar code */
+	if(sha256_hw_select(0)){
+		goto err;
+	}
+#endif
+	if(sha256_run_tests("scalar")){
+		goto err;
+	}
+	printf("[+] All tests for SHA-224/SHA-256 are OK! :-)\n");
+
+	ret = 0;
+err:
+#ifdef WITH_SHA256_HW
+	/* Back to the default choice */
+	if(sha256_hw_available()){
+		sha256_hw_select(1);
+	}
+#endif
+	return ret;
+}
+
+#else
+/*
+ * Dummy definition to avoid the empty translation unit ISO C warning
+ */
+typedef int dummy;
+#endif
@@ -0,0 +1,38 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifndef __SHA256_TESTS_H__
+#define __SHA256_TESTS_H__
+
+#include "libhash_config.h"
+
+#if defined(WITH_HASH_SHA256) || defined(WITH_HASH_SHA224)
+
+#include "sha224.h"
+#include "sha256.h"
+#include "sha256_hw.h"
+
+typedef struct {
+        const char *name;
+        /* Message, NULL for one million 'a' */
+        const char *msg;
+        /* Expected digest */
+        const char *digest;
+} sha256_self_test;
+
+#include <stdio.h>
+/* FIPS 180-4 known answers of SHA-224 and SHA-256, with the scalar code
+ * and with the SHA instructions when the CPU has them
+ */
+int do_sha256_self_tests(void);
+
+#endif
+
+#endif /* __SHA256_TESTS_H__ */
@@ -8,6 +8,9 @@
  *  See LICENSE file at the root folder of the project.
  */
 
+/* clock_gettime() */
+#define _POSIX_C_SOURCE 200809L
+
 #include "entropy.h"
 
 #include <stdlib.h>
@@ -23,10 +26,11 @@
 #include <termios.h>
 #include <sys/select.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #define SERIAL_PORT "/dev/ttyACM0"
 #define SERIAL_BAUDRATE 460800 // 串口波特率
-#define READ_BUF_SIZE 1024	   // 读取缓冲区大小
 
 int serial_init(const char *port, int baudrate)
 {
@@ -76,171 +80,442 @@ int serial_init(const char *port, int baudrate)
 }
 
 /*
- * Copy file content to buffer. Return 0 on success, i.e. if the request
- * size has been read and copied to buffer and -1 otherwise.
+ * Persistent entropy source: the serial channel to the cube is opened and
+ * configured once, then kept open. Entropy is requested in bulk ("OR"
+ * commands issued back to back on the same descriptor) into a ring buffer
+ * from which get_entropy_input is served. On any I/O error or read timeout
+ * (e.g. the device has been reset or re-enumerated) the descriptor is closed
+ * and the port is reopened once before giving up.
+ *
+ * Several DRBG instances may draw from the source concurrently: each request
+ * is copied out of the shared ring into a per-thread staging buffer, so that
+ * clearing one instance's input never touches bytes handed to another one.
+ *
+ * The lock only protects the ring and the bookkeeping, never the exchange with
+ * the device: one thread at a time refills, reading into the incoming buffer
+ * without the lock and committing the bytes into the ring afterwards. Other
+ * threads needing a refill wait for it, and closing the channel meanwhile is
+ * deferred to the end of the refill.
+ *
+ * The port can also be lent to another user (QRServer's own serial exchanges)
+ * between entropy_source_suspend() and entropy_source_resume(): the running
+ * refill stops after its current command, and no refill starts until the port
+ * is handed back. Requests the ring can still serve are not delayed.
  */
-static int fimport(uint8_t *buf, uint32_t buflen, const char *path)
+#define ENTROPY_CMD_LEN		1024	/* Bytes returned by the cube per "OR" command */
+#define ENTROPY_RING_LEN	(16 * ENTROPY_CMD_LEN)
+#define ENTROPY_MAX_REQUEST	1024	/* Maximum size of one get_entropy_input request */
+/* Outstanding requests per thread: instantiation holds entropy input and nonce */
+#define ENTROPY_STAGING_SLOTS	2
+#define ENTROPY_READ_TIMEOUT_MS	2000
+
+typedef struct
+{
+	int fd;	/* Owned by the refilling thread while refilling is set */
+	bool refilling;	/* A thread is talking to the device, without the lock */
+	bool close_pending;	/* Close the channel once the running refill is over */
+	uint32_t suspended;	/* Pending entropy_source_suspend() calls */
+	uint8_t ring[ENTROPY_RING_LEN];
+	uint32_t head;	/* Read index in the ring */
+	uint32_t count;	/* Number of available bytes starting at head */
+	uint64_t delivered;	/* Bytes received from the device */
+	uint64_t busy_us;	/* Time spent talking to the device */
+	uint8_t incoming[ENTROPY_RING_LEN];	/* Owned by the refilling thread */
+} entropy_source;
+
+static entropy_source curr_entropy_source = { .fd = -1, .refilling = false, .close_pending = false, .suspended = 0, .head = 0, .count = 0, .delivered = 0, .busy_us = 0 };
+/* The DRBG and the port owner (QRServer) run on different threads */
+static pthread_mutex_t curr_entropy_source_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when a refill is over or the source is resumed */
+static pthread_cond_t curr_entropy_source_cond = PTHREAD_COND_INITIALIZER;
+
+static __thread uint8_t entropy_staging[ENTROPY_STAGING_SLOTS][ENTROPY_MAX_REQUEST];
+static __thread uint32_t entropy_staging_next;
+
+static uint64_t entropy_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+static int _entropy_source_open(void)
 {
-	uint32_t rem = buflen, copied = 0;
-	ssize_t ret;
-	int fd;
+	int ret = -1;
 
-	if ((buf == NULL) || (path == NULL))
+	if (curr_entropy_source.fd >= 0)
 	{
-		ret = -1;
+		ret = 0;
 		goto err;
 	}
 
-	fd = serial_init(SERIAL_PORT, SERIAL_BAUDRATE); // 初始化串口
-	if (fd == -1)
+	curr_entropy_source.fd = serial_init(SERIAL_PORT, SERIAL_BAUDRATE);
+	if (curr_entropy_source.fd < 0)
 	{
-		fprintf(stderr, "Failed to initialize serial port.\n");
-		return 1;
+		fprintf(stderr, "Failed to initialize serial port %s.\n", SERIAL_PORT);
+		goto err;
 	}
 
-	// 写入数据到串口
-	uint8_t message[2] = {0x4F, 0x52};
-	if (write(fd, message, sizeof(message)) != sizeof(message))
-	{
-		perror("write");
-		return -1;
-		goto close_fd;
-	}
+	ret = 0;
+err:
+	return ret;
+}
 
-	// 读取数据
-	while (rem)
+static void _entropy_source_close(void)
+{
+	if (curr_entropy_source.fd >= 0)
 	{
-		ret = (int)read(fd, buf + copied, rem);
-		if (ret <= 0)
-		{
-			break;
-		}
-		else
+		if (close(curr_entropy_source.fd))
 		{
-			rem = (uint32_t)(rem - ret);
-			copied = (uint32_t)(copied + ret);
+			perror("close");
 		}
+		curr_entropy_source.fd = -1;
 	}
+}
+
+int entropy_source_open(void)
+{
+	int ret = 0;
 
-close_fd:
-	if (close(fd))
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	if (curr_entropy_source.suspended)
 	{
-		printf("Unable to close input file %s\n", path);
 		ret = -1;
 	}
+	/* A running refill opens the channel itself */
+	else if (!curr_entropy_source.refilling)
+	{
+		ret = _entropy_source_open();
+	}
+	pthread_mutex_unlock(&curr_entropy_source_lock);
 
-	ret = (copied == buflen) ? 0 : -1;
+	return ret;
+}
 
-err:
-	return (int)ret;
+void entropy_source_close(void)
+{
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	if (curr_entropy_source.refilling)
+	{
+		curr_entropy_source.close_pending = true;
+	}
+	else
+	{
+		_entropy_source_close();
+	}
+	pthread_mutex_unlock(&curr_entropy_source_lock);
+}
+
+void entropy_source_suspend(void)
+{
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	curr_entropy_source.suspended++;
+	while (curr_entropy_source.refilling)
+	{
+		pthread_cond_wait(&curr_entropy_source_cond, &curr_entropy_source_lock);
+	}
+	_entropy_source_close();
+	pthread_mutex_unlock(&curr_entropy_source_lock);
 }
 
-static int _get_entropy_input_from_os(uint8_t *buf, uint32_t len)
+void entropy_source_resume(void)
 {
-	int ret;
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	if (curr_entropy_source.suspended)
+	{
+		curr_entropy_source.suspended--;
+	}
+	pthread_cond_broadcast(&curr_entropy_source_cond);
+	pthread_mutex_unlock(&curr_entropy_source_lock);
+}
 
-	ret = fimport(buf, len, "/dev/ttyACM0");
+static bool entropy_source_is_suspended(void)
+{
+	bool ret;
+
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	ret = (curr_entropy_source.suspended != 0);
+	pthread_mutex_unlock(&curr_entropy_source_lock);
 
 	return ret;
 }
 
-#define ENTROPY_BUFF_LEN 1024
-
-/* The entropy */
-typedef struct
+/*
+ * Read exactly len bytes from the channel, waiting at most
+ * ENTROPY_READ_TIMEOUT_MS for each chunk. Return 0 on success, -1 otherwise.
+ */
+static int entropy_source_read_exact(uint8_t *buf, uint32_t len)
 {
-	uint8_t entropy_buff[ENTROPY_BUFF_LEN];
-	uint32_t entropy_buff_pos;
-	uint32_t entropy_buff_len;
-} entropy_pool;
+	uint32_t rem = len, copied = 0;
+	struct timeval tv;
+	fd_set rfds;
+	ssize_t n;
+	int ret = -1;
 
-static bool curr_entropy_pool_init = false;
-static entropy_pool curr_entropy_pool;
+	while (rem)
+	{
+		FD_ZERO(&rfds);
+		FD_SET(curr_entropy_source.fd, &rfds);
+		tv.tv_sec = ENTROPY_READ_TIMEOUT_MS / 1000;
+		tv.tv_usec = (ENTROPY_READ_TIMEOUT_MS % 1000) * 1000;
 
-int get_entropy_input(uint8_t **buf, uint32_t len, bool prediction_resistance)
+		n = select(curr_entropy_source.fd + 1, &rfds, NULL, NULL, &tv);
+		if ((n < 0) && (errno == EINTR))
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			fprintf(stderr, "Entropy source: %s\n", (n == 0) ? "read timeout" : strerror(errno));
+			goto err;
+		}
+
+		n = read(curr_entropy_source.fd, buf + copied, rem);
+		if ((n < 0) && (errno == EINTR))
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			/* 0 means the device went away (hangup) */
+			fprintf(stderr, "Entropy source: %s\n", (n == 0) ? "device hangup" : strerror(errno));
+			goto err;
+		}
+		rem = (uint32_t)(rem - n);
+		copied = (uint32_t)(copied + n);
+	}
+
+	ret = 0;
+err:
+	return ret;
+}
+
+/*
+ * Read ncmd * ENTROPY_CMD_LEN fresh bytes into buf, one "OR" command at a time.
+ * Called without the lock by the refilling thread; stops early (successfully)
+ * when the source gets suspended. Return 0 on success, -1 otherwise; in both
+ * cases *received is the number of bytes read.
+ */
+static int entropy_source_request(uint8_t *buf, uint32_t ncmd, uint32_t *received)
 {
+	const uint8_t message[2] = {0x4F, 0x52};
+	uint32_t i;
 	int ret = -1;
 
-	/* Avoid unused parameter warnings */
-	(void)prediction_resistance;
+	(*received) = 0;
 
-	if (curr_entropy_pool_init == false)
+	if (_entropy_source_open())
 	{
-		/* Initialize our entropy pool */
-		memset(curr_entropy_pool.entropy_buff, 0, sizeof(curr_entropy_pool.entropy_buff));
-		curr_entropy_pool.entropy_buff_pos = curr_entropy_pool.entropy_buff_len = 0;
+		goto err;
+	}
+
+	/* Drop stale bytes, e.g. left over from an interrupted transfer */
+	tcflush(curr_entropy_source.fd, TCIFLUSH);
 
-		curr_entropy_pool_init = true;
+	for (i = 0; i < ncmd; i++)
+	{
+		if (entropy_source_is_suspended())
+		{
+			break;
+		}
+		if (write(curr_entropy_source.fd, message, sizeof(message)) != sizeof(message))
+		{
+			perror("write");
+			goto err;
+		}
+		if (entropy_source_read_exact(buf + (*received), ENTROPY_CMD_LEN))
+		{
+			goto err;
+		}
+		(*received) += ENTROPY_CMD_LEN;
 	}
 
-	/* Sanity check */
-	if (buf == NULL)
+	ret = 0;
+err:
+	return ret;
+}
+
+/*
+ * Append len bytes after the current ring content, wrapping around the end of
+ * the ring. The caller holds the lock and checked that they fit.
+ */
+static void entropy_source_commit(const uint8_t *buf, uint32_t len)
+{
+	uint32_t wpos, chunk, copied = 0;
+
+	while (copied < len)
 	{
-		goto err;
+		wpos = (curr_entropy_source.head + curr_entropy_source.count) % ENTROPY_RING_LEN;
+		chunk = ENTROPY_RING_LEN - wpos;
+		if (chunk > (len - copied))
+		{
+			chunk = len - copied;
+		}
+		memcpy(curr_entropy_source.ring + wpos, buf + copied, chunk);
+		curr_entropy_source.count += chunk;
+		copied += chunk;
 	}
+	curr_entropy_source.delivered += len;
+}
 
-	(*buf) = NULL;
+/*
+ * Refill the free part of the ring. Called with the lock held, which is
+ * released while talking to the device. If another thread is already
+ * refilling or the source is suspended, wait for that to end instead and
+ * return 0: the caller checks the ring again. On failure the channel is
+ * reopened once (device reset) and the request is retried.
+ */
+static int entropy_source_refill(void)
+{
+	uint32_t ncmd, received, more;
+	uint64_t start, busy;
+	int ret = -1;
 
-	/* If we ask for more than the size of our entropy pool, return an error ... */
-	if (len > sizeof(curr_entropy_pool.entropy_buff))
+	if (curr_entropy_source.refilling || curr_entropy_source.suspended)
 	{
+		while (curr_entropy_source.refilling || curr_entropy_source.suspended)
+		{
+			pthread_cond_wait(&curr_entropy_source_cond, &curr_entropy_source_lock);
+		}
+		ret = 0;
 		goto err;
 	}
-	else if (len <= curr_entropy_pool.entropy_buff_len)
+
+	/* The ring only loses bytes while unlocked, so this much space stays free */
+	ncmd = (ENTROPY_RING_LEN - curr_entropy_source.count) / ENTROPY_CMD_LEN;
+	if (ncmd == 0)
 	{
-		(*buf) = (curr_entropy_pool.entropy_buff + curr_entropy_pool.entropy_buff_pos);
-		/* Remove the consumed data */
-		curr_entropy_pool.entropy_buff_pos += len;
-		curr_entropy_pool.entropy_buff_len -= len;
+		goto err;
 	}
-	else
+
+	curr_entropy_source.refilling = true;
+	pthread_mutex_unlock(&curr_entropy_source_lock);
+
+	start = entropy_now_us();
+	ret = entropy_source_request(curr_entropy_source.incoming, ncmd, &received);
+	if (ret && !entropy_source_is_suspended())
 	{
-		/* We do not have enough remaining data, reset and ask for maximum */
-		ret = _get_entropy_input_from_os(curr_entropy_pool.entropy_buff, sizeof(curr_entropy_pool.entropy_buff));
+		/* Keep the bytes already received, then start over on a fresh descriptor */
+		_entropy_source_close();
+		ret = entropy_source_request(curr_entropy_source.incoming + received, ncmd - (received / ENTROPY_CMD_LEN), &more);
+		received += more;
 		if (ret)
 		{
-			goto err;
+			_entropy_source_close();
 		}
-		curr_entropy_pool.entropy_buff_pos = 0;
-		curr_entropy_pool.entropy_buff_len = sizeof(curr_entropy_pool.entropy_buff);
-		(*buf) = curr_entropy_pool.entropy_buff;
 	}
+	busy = entropy_now_us() - start;
 
-	/* Sanity checks */
-	if (curr_entropy_pool.entropy_buff_pos > sizeof(curr_entropy_pool.entropy_buff))
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	entropy_source_commit(curr_entropy_source.incoming, received);
+	memset(curr_entropy_source.incoming, 0, received);
+	curr_entropy_source.busy_us += busy;
+	if (curr_entropy_source.close_pending)
 	{
-		goto err;
+		_entropy_source_close();
+		curr_entropy_source.close_pending = false;
 	}
-	if (curr_entropy_pool.entropy_buff_len > sizeof(curr_entropy_pool.entropy_buff))
+	/* Stopped for a suspend: the caller waits for the resume and tries again */
+	if (curr_entropy_source.suspended)
 	{
-		goto err;
+		ret = 0;
 	}
-
-	ret = 0;
+	curr_entropy_source.refilling = false;
+	pthread_cond_broadcast(&curr_entropy_source_cond);
 
 err:
-	if (ret && (buf != NULL))
-	{
-		(*buf) = NULL;
-	}
 	return ret;
 }
 
-int clear_entropy_input(uint8_t *buf)
+int get_entropy_input(uint8_t **buf, uint32_t len, bool prediction_resistance)
 {
+	uint8_t *out;
+	uint32_t chunk, copied;
 	int ret = -1;
-	uint8_t *buf_max = (curr_entropy_pool.entropy_buff + curr_entropy_pool.entropy_buff_pos);
+
+	/* Avoid unused parameter warnings */
+	(void)prediction_resistance;
 
 	/* Sanity check */
-	if ((buf < curr_entropy_pool.entropy_buff) || (buf > buf_max))
+	if (buf == NULL)
 	{
-		goto err;
+		return -1;
+	}
+
+	(*buf) = NULL;
+
+	if ((len == 0) || (len > ENTROPY_MAX_REQUEST))
+	{
+		return -1;
 	}
 
-	/* Clean the buffer until pos */
-	memset(curr_entropy_pool.entropy_buff, 0, curr_entropy_pool.entropy_buff_pos);
+	out = entropy_staging[entropy_staging_next];
 
+	pthread_mutex_lock(&curr_entropy_source_lock);
+
+	while (len > curr_entropy_source.count)
+	{
+		if (entropy_source_refill())
+		{
+			goto err;
+		}
+	}
+
+	/* Copy out (the ring may wrap) and remove the consumed data */
+	copied = 0;
+	while (copied < len)
+	{
+		chunk = ENTROPY_RING_LEN - curr_entropy_source.head;
+		if (chunk > (len - copied))
+		{
+			chunk = len - copied;
+		}
+		memcpy(out + copied, curr_entropy_source.ring + curr_entropy_source.head, chunk);
+		memset(curr_entropy_source.ring + curr_entropy_source.head, 0, chunk);
+		curr_entropy_source.head = (curr_entropy_source.head + chunk) % ENTROPY_RING_LEN;
+		curr_entropy_source.count -= chunk;
+		copied += chunk;
+	}
+
+	entropy_staging_next = (entropy_staging_next + 1) % ENTROPY_STAGING_SLOTS;
+	(*buf) = out;
 	ret = 0;
+
 err:
+	pthread_mutex_unlock(&curr_entropy_source_lock);
 	return ret;
-}
\ No newline at end of file
+}
+
+int clear_entropy_input(uint8_t *buf)
+{
+	uint32_t i;
+
+	/* Sanity check: only buffers handed out to this thread can be cleared */
+	for (i = 0; i < ENTROPY_STAGING_SLOTS; i++)
+	{
+		if (buf == entropy_staging[i])
+		{
+			memset(buf, 0, ENTROPY_MAX_REQUEST);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int entropy_source_get_stats(uint64_t *delivered, uint64_t *busy_us)
+{
+	if ((delivered == NULL) || (busy_us == NULL))
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&curr_entropy_source_lock);
+	(*delivered) = curr_entropy_source.delivered;
+	(*busy_us) = curr_entropy_source.busy_us;
+	pthread_mutex_unlock(&curr_entropy_source_lock);
+
+	return 0;
+}
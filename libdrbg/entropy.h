@@ -20,4 +20,29 @@ int get_entropy_input(uint8_t **in, uint32_t len, bool prediction_resistance);
 
 int clear_entropy_input(uint8_t *buf);
 
+/*
+ * The serial channel to the entropy source stays open between refills.
+ * entropy_source_close() releases the port so that another user can open it;
+ * the next refill transparently reopens it. It never waits for the device: if
+ * a refill is running, the port is closed as soon as that refill is over.
+ */
+int entropy_source_open(void);
+
+void entropy_source_close(void);
+
+/*
+ * Lend the port to another user: entropy_source_suspend() returns once the
+ * running refill (if any) has stopped and the port is closed; no refill starts
+ * until the matching entropy_source_resume(). Calls may nest.
+ */
+void entropy_source_suspend(void);
+
+void entropy_source_resume(void);
+
+/*
+ * Bytes received from the device and cumulated time spent waiting for it
+ * (microseconds), used to estimate how saturated the channel is.
+ */
+int entropy_source_get_stats(uint64_t *delivered, uint64_t *busy_us);
+
 #endif /* __ENTROPY_H__ */
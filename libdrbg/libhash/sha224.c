@@ -13,6 +13,7 @@
 #ifdef WITH_HASH_SHA224
 
 #include "sha224.h"
+#include "sha256_hw.h"
 
 /* SHA-2 core processing. Returns 0 on success, -1 on error. */
 static int sha224_process(sha224_context *ctx,
@@ -26,6 +27,14 @@ static int sha224_process(sha224_context *ctx,
 	MUST_HAVE((data != NULL), ret, err);
 	SHA224_HASH_CHECK_INITIALIZED(ctx, ret, err);
 
+#ifdef WITH_SHA256_HW
+	if(sha256_hw_enabled()){
+		sha256_hw_process(ctx->sha224_state, data, 1);
+		ret = 0;
+		goto err;
+	}
+#endif
+
 	/* Init our inner variables */
 	a = ctx->sha224_state[0];
 	b = ctx->sha224_state[1];
@@ -13,6 +13,7 @@
 #ifdef WITH_HASH_SHA256
 
 #include "sha256.h"
+#include "sha256_hw.h"
 
 /* SHA-2 core processing */
 static int sha256_process(sha256_context *ctx,
@@ -26,6 +27,14 @@ static int sha256_process(sha256_context *ctx,
 	MUST_HAVE((data != NULL), ret, err);
 	SHA256_HASH_CHECK_INITIALIZED(ctx, ret, err);
 
+#ifdef WITH_SHA256_HW
+	if(sha256_hw_enabled()){
+		sha256_hw_process(ctx->sha256_state, data, 1);
+		ret = 0;
+		goto err;
+	}
+#endif
+
 	/* Init our inner variables */
 	a = ctx->sha256_state[0];
 	b = ctx->sha256_state[1];
@@ -121,6 +130,14 @@ int sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t ilen)
 		left = 0;
 	}
 
+#ifdef WITH_SHA256_HW
+	/* All the full blocks at once through the instructions */
+	if ((remain_ilen >= SHA256_BLOCK_SIZE) && sha256_hw_enabled()) {
+		sha256_hw_process(ctx->sha256_state, data_ptr, remain_ilen / SHA256_BLOCK_SIZE);
+		data_ptr += remain_ilen - (remain_ilen % SHA256_BLOCK_SIZE);
+		remain_ilen %= SHA256_BLOCK_SIZE;
+	}
+#endif
 	while (remain_ilen >= SHA256_BLOCK_SIZE) {
 		ret = sha256_process(ctx, data_ptr); EG(ret, err);
 		data_ptr += SHA256_BLOCK_SIZE;
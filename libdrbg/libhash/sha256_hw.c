@@ -0,0 +1,212 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#include "libhash_config.h"
+
+#if defined(WITH_HASH_SHA256) || defined(WITH_HASH_SHA224)
+#include "sha256_hw.h"
+#endif
+
+#if (defined(WITH_HASH_SHA256) || defined(WITH_HASH_SHA224)) && defined(WITH_SHA256_HW)
+#include "sha2.h"
+
+/* Detection state: -1 not done yet, then 0 or 1 */
+static int sha256_hw_state = -1;
+/* Set by sha256_hw_select(0) */
+static int sha256_hw_bypass = 0;
+
+/* The 16 steps of four rounds are fully unrolled */
+#if defined(__clang__) || (__GNUC__ >= 8)
+#define SHA256_HW_UNROLL	_Pragma("GCC unroll 16")
+#else
+#define SHA256_HW_UNROLL
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA256_HW_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+
+/* Unaligned 16 bytes load */
+#define SHA256_HW_LOAD(p)	_mm_loadu_si128((const __m128i*)(const void*)(p))
+
+static int sha256_hw_detect_cpu(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if(__get_cpuid_max(0, NULL) < 7){
+		return 0;
+	}
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+		return 0;
+	}
+	if(((ecx & bit_SSSE3) == 0) || ((ecx & bit_SSE4_1) == 0)){
+		return 0;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & bit_SHA) != 0;
+}
+
+SHA256_HW_TARGET
+void sha256_hw_process(uint32_t state[8], const uint8_t *data, uint32_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i abef, cdgh, abef_save, cdgh_save, tmp, msg, w[4];
+	unsigned int i;
+
+	/* The instructions work on the ABEF and CDGH halves of the state */
+	tmp = _mm_shuffle_epi32(SHA256_HW_LOAD(&state[0]), 0xB1);
+	cdgh = _mm_shuffle_epi32(SHA256_HW_LOAD(&state[4]), 0x1B);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+	for(; nblocks > 0; nblocks--){
+		abef_save = abef;
+		cdgh_save = cdgh;
+		/* Four rounds per step, the message schedule four words ahead */
+		SHA256_HW_UNROLL
+		for(i = 0; i < 16; i++){
+			if(i < 4){
+				w[i] = _mm_shuffle_epi8(SHA256_HW_LOAD(&data[16 * i]), bswap);
+			}
+			else{
+				w[i & 3] = _mm_sha256msg2_epu32(
+					_mm_add_epi32(_mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]),
+						      _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4)),
+					w[(i + 3) & 3]);
+			}
+			msg = _mm_add_epi32(w[i & 3], SHA256_HW_LOAD(&K_SHA256[4 * i]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+		}
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+		data += 64;
+	}
+
+	tmp = _mm_shuffle_epi32(abef, 0x1B);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+	_mm_storeu_si128((__m128i*)(void*)&state[0], _mm_blend_epi16(tmp, cdgh, 0xF0));
+	_mm_storeu_si128((__m128i*)(void*)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_neon.h>
+
+#ifdef __clang__
+#define SHA256_HW_TARGET	__attribute__((target("sha2")))
+#else
+#define SHA256_HW_TARGET	__attribute__((target("+crypto")))
+#endif
+
+static int sha256_hw_detect_cpu(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+
+SHA256_HW_TARGET
+void sha256_hw_process(uint32_t state[8], const uint8_t *data, uint32_t nblocks)
+{
+	uint32x4_t abcd, efgh, abcd_save, efgh_save, prev, msg, w[4];
+	unsigned int i;
+
+	abcd = vld1q_u32(&state[0]);
+	efgh = vld1q_u32(&state[4]);
+
+	for(; nblocks > 0; nblocks--){
+		abcd_save = abcd;
+		efgh_save = efgh;
+		/* Four rounds per step, the message schedule four words ahead */
+		SHA256_HW_UNROLL
+		for(i = 0; i < 16; i++){
+			if(i < 4){
+				w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&data[16 * i])));
+			}
+			else{
+				w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+							   w[(i + 2) & 3], w[(i + 3) & 3]);
+			}
+			msg = vaddq_u32(w[i & 3], vld1q_u32(&K_SHA256[4 * i]));
+			prev = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, msg);
+			efgh = vsha256h2q_u32(efgh, prev, msg);
+		}
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+		data += 64;
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+#endif
+
+/* One block check: the compression of "abc" (padded) from the initial
+ * state gives the SHA-256 digest of "abc"
+ */
+static int sha256_hw_self_test(void)
+{
+	static const uint32_t expected[8] = {
+		0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+		0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad
+	};
+	uint32_t state[8] = {
+		0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+		0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+	};
+	uint8_t block[64];
+
+	memset(block, 0, sizeof(block));
+	block[0] = 'a';
+	block[1] = 'b';
+	block[2] = 'c';
+	block[3] = 0x80;
+	block[63] = 24;
+	sha256_hw_process(state, block, 1);
+
+	return memcmp(state, expected, sizeof(state)) == 0;
+}
+
+int sha256_hw_available(void)
+{
+	int state = __atomic_load_n(&sha256_hw_state, __ATOMIC_RELAXED);
+
+	if(state < 0){
+		state = sha256_hw_detect_cpu() && sha256_hw_self_test();
+		__atomic_store_n(&sha256_hw_state, state, __ATOMIC_RELAXED);
+	}
+	return state;
+}
+
+int sha256_hw_enabled(void)
+{
+	return (!__atomic_load_n(&sha256_hw_bypass, __ATOMIC_RELAXED)) && sha256_hw_available();
+}
+
+int sha256_hw_select(int use_hw)
+{
+	if(use_hw && !sha256_hw_available()){
+		return -1;
+	}
+	__atomic_store_n(&sha256_hw_bypass, !use_hw, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+#else
+/*
+ * Dummy definition to avoid the empty translation unit ISO C warning
+ */
+typedef int dummy;
+#endif
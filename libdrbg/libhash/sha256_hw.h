@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2022 - This file is part of libdrbg project
+ *
+ *  Author:       Ryad BENADJILA <ryad.benadjila@ssi.gouv.fr>
+ *  Contributor:  Arnaud EBALARD <arnaud.ebalard@ssi.gouv.fr>
+ *
+ *  This software is licensed under a dual BSD and GPL v2 license.
+ *  See LICENSE file at the root folder of the project.
+ */
+
+#ifndef __SHA256_HW_H__
+#define __SHA256_HW_H__
+
+#include "utils.h"
+
+/*
+ * SHA-256 compression with the SHA extensions (x86) or the ARMv8 SHA2
+ * instructions (AArch64 Linux), used by SHA-224 and SHA-256 when the CPU
+ * has them. The scalar code stays the fallback. Define NO_SHA_HW to only
+ * use the scalar code.
+ */
+#if !defined(NO_SHA_HW) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__) || \
+     (defined(__aarch64__) && defined(__linux__) && !defined(__AARCH64EB__)))
+#define WITH_SHA256_HW
+
+/* Non zero if the CPU has the instructions and they pass a known answer
+ * check (detected once, at the first use)
+ */
+int sha256_hw_available(void);
+
+/* Non zero if SHA-224 and SHA-256 go through the instructions */
+int sha256_hw_enabled(void);
+
+/* Use (use_hw != 0) or bypass the instructions. Returns -1 if they are
+ * not available.
+ */
+int sha256_hw_select(int use_hw);
+
+/* Compress nblocks blocks of 64 bytes into the state */
+void sha256_hw_process(uint32_t state[8], const uint8_t *data, uint32_t nblocks);
+#endif
+
+#endif /* __SHA256_HW_H__ */
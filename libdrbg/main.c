@@ -9,6 +9,8 @@
  */
 
 #include "ctr_drbg_tests.h"
+#include "sha256_tests.h"
+#include "aes_tests.h"
 // #include "drbg_tests/test_vectors/ctr_drbg_tests_cases.h"
 #include "drbg.h"
 #include "drbg_common.h"
@@ -34,6 +36,20 @@ int main(int argc, char *argv[])
 {
 	((void)argc);
 	((void)argv);
+#if defined(WITH_HASH_SHA256) || defined(WITH_HASH_SHA224)
+	/* Known answers of SHA-224/SHA-256, scalar and with the SHA instructions */
+	if (do_sha256_self_tests())
+	{
+		goto err;
+	}
+#endif
+#ifdef WITH_BC_AES
+	/* FIPS-197 known answers and multiple blocks encryption of every AES implementation */
+	if (do_aes_self_tests())
+	{
+		goto err;
+	}
+#endif
 	{
 		drbg_ctx drbg;
 		drbg_error ret;
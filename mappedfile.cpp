@@ -0,0 +1,64 @@
+#include "mappedfile.h"
+#include <QDebug>
+#include <sys/mman.h>
+
+MappedFile::MappedFile(const QString &path)
+    : m_file(path), m_data(nullptr), m_size(0), m_map(nullptr)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open()
+{
+    close();
+    if (!m_file.open(QFile::ReadOnly)) {
+        qDebug() << "打开文件失败:" << m_file.fileName();
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size == 0)
+        return true;
+
+    m_map = m_file.map(0, m_size);
+    if (m_map) {
+        posix_madvise(m_map, static_cast<size_t>(m_size), POSIX_MADV_SEQUENTIAL);
+        m_data = m_map;
+        return true;
+    }
+
+    //映射失败(如特殊文件系统),读入内存
+    m_buffer = m_file.readAll();
+    if (m_buffer.size() != m_size) {
+        qDebug() << "读取文件失败:" << m_file.fileName();
+        close();
+        return false;
+    }
+    m_data = reinterpret_cast<const unsigned char *>(m_buffer.constData());
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_buffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+    if (m_file.isOpen())
+        m_file.close();
+}
+
+QByteArray MappedFile::bytes(qint64 offset, qint64 len) const
+{
+    if (offset < 0 || offset > m_size)
+        return QByteArray();
+    if (len < 0 || len > m_size - offset)
+        len = m_size - offset;
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data) + offset, static_cast<int>(len));
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+/**
+ * 只读映射整个文件,供NIST测试、哈希和分包发送原地读取,文件只从磁盘读一次
+ * 映射时提示内核顺序读取(MADV_SEQUENTIAL);无法映射时退回一次readAll
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const QString &path);
+    ~MappedFile();
+
+    bool open();
+    void close();
+
+    const unsigned char *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    QByteArray bytes(qint64 offset = 0, qint64 len = -1) const;//不复制,只在MappedFile存在期间有效
+
+private:
+    QFile m_file;
+    const unsigned char *m_data;
+    qint64 m_size;
+    uchar *m_map;
+    QByteArray m_buffer;//映射失败时的内容
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+#endif // MAPPEDFILE_H
@@ -40,6 +40,31 @@ computeRank(int M, int Q, BitSequence **matrix)
 	return rank;
 }
 
+/*
+ * Rank of a 32x32 matrix given as 32 rows of 32 bits, by Gaussian
+ * elimination with row XORs. Each nonzero row picks its lowest set bit as
+ * pivot and clears that column from the rows below it. The rows are
+ * overwritten.
+ */
+int
+computeRank32(uint32_t *rows)
+{
+	int		i, j, rank = 0;
+	uint32_t	pivot;
+
+	for ( i=0; i<32; i++ ) {
+		if ( rows[i] == 0 )
+			continue;
+		pivot = (uint32_t)1 << __builtin_ctz(rows[i]);
+		for ( j=i+1; j<32; j++ )
+			if ( rows[j] & pivot )
+				rows[j] ^= rows[i];
+		rank++;
+	}
+
+	return rank;
+}
+
 void
 perform_elementary_row_operations(int flag, int i, int M, int Q, BitSequence **A)
 {
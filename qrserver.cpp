@@ -1,4 +1,5 @@
 #include "qrserver.h"
+#include "mappedfile.h"
 #include <unistd.h>
 #include "sts.h"
 #include <QNetworkInterface>
@@ -36,6 +37,42 @@ QRServer::QRServer(QObject *parent) : QObject(parent)
     StatusPath = currentPath+"/QR-randomStatus.csv";
     initializeFileStatus(StatusPath);
 
+    //每个编号一个DRBG实例,个性化字符串包含编号
+    for (int fileNumber = 1; fileNumber <= walletAddrCount; ++fileNumber) {
+        drbgProducers.append(new DrbgProducer(QByteArray("DRBG_PERS") + QByteArray::number(fileNumber)));
+    }
+
+    //随机数生产流水线放到独立线程,结果通过队列连接回到本线程
+    randomWorkerCount = settings->value("random/workers", QThread::idealThreadCount()).toInt();
+    randomWorkerCount = qBound(1, randomWorkerCount, static_cast<int>(walletAddrCount));
+    randomWorkerLimit = randomWorkerCount;
+    qDebug() << "随机数并行生产数:" << randomWorkerCount;
+    //NIST测试内存上限(MB,所有生产线程合计,0不限制),平均分给各生产线程
+    qint64 stsMemory = settings->value("random/stsMemoryMB", 0).toLongLong() * 1024 * 1024;
+    size_t stsBudget = static_cast<size_t>(qMax<qint64>(0, stsMemory) / randomWorkerCount);
+    //低于最省内存的布局时每个文件都会立即失败并被反复分配,按最小值分配
+    size_t stsMinBudget = sts_workspace_min_budget(STS_SEQUENCE_BITS);
+    if (stsBudget != 0 && stsBudget < stsMinBudget) {
+        qWarning() << "NIST测试内存上限过小:每个生产线程" << stsBudget << "字节,至少需要" << stsMinBudget << "字节,已按最小值分配";
+        stsBudget = stsMinBudget;
+    }
+    for (int i = 0; i < randomWorkerCount; ++i) {
+        QThread *thread = new QThread(this);
+        RandomWorker *worker = new RandomWorker(drbgProducers, stsBudget);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(worker, &RandomWorker::randomProduced, this, &QRServer::onRandomProduced);
+        thread->start();
+        randomThreads.append(thread);
+        randomWorkers.append(worker);
+        if (worker->isReady()) {
+            idleRandomWorkers.append(worker);
+        } else {
+            qWarning() << "NIST测试内存创建失败,生产线程" << i << "不参与随机数补充";
+        }
+    }
+    entropyTimer.start();
+
     setupLogDeletion(1, 7);
 }
 
@@ -105,6 +142,14 @@ void QRServer::startServer(const QBluetoothAddress &localAdapter) {
 
 QRServer::~QRServer() {
     stopServer();
+    if (global_port.isOpen()) {
+        closeGlobalPort();//恢复熵源,否则等待熵的生产线程无法退出
+    }
+    for (QThread *thread : randomThreads) {
+        thread->quit();
+        thread->wait();
+    }
+    qDeleteAll(drbgProducers);
 }
 
 void QRServer::stopServer() {
@@ -120,16 +165,11 @@ void QRServer::stopServer() {
 
     m_TcpSocket->disconnectFromHost();
 
+    stopRandom();
     if(randomTimer){
-        randomTimer->stop();
         delete randomTimer;
         randomTimer = nullptr;
     }
-    if(drbgTimer){
-        drbgTimer->stop();
-        delete drbgTimer;
-        drbgTimer = nullptr;
-    }
     if(connectTimer){
         connectTimer->stop();
         delete connectTimer;
@@ -364,7 +404,7 @@ void QRServer::getWalletAddr()
 
 void QRServer::addKey(QString strCount)
 {
-    if (!global_port.open(QIODevice::ReadWrite)){
+    if (!openGlobalPort()){
         qDebug() << "无法打开串口，错误：" << global_port.errorString();
         blinkLed(0,1000,2,3);
         return;
@@ -398,6 +438,26 @@ void QRServer::addKey(QString strCount)
     });
 }
 
+/**
+ * global_port与熵源共用同一串口:打开前暂停熵源(等待正在进行的补充停止,之后的补充阻塞),关闭后恢复
+ * 随机数生产线程在熵池取空时阻塞等待,不会与global_port同时读写串口
+ */
+bool QRServer::openGlobalPort()
+{
+    DrbgProducer::suspendEntropySource();
+    if (global_port.open(QIODevice::ReadWrite)) {
+        return true;
+    }
+    DrbgProducer::resumeEntropySource();
+    return false;
+}
+
+void QRServer::closeGlobalPort()
+{
+    global_port.close();
+    DrbgProducer::resumeEntropySource();
+}
+
 void QRServer::decompressKeytowalletAddr(QString strCount)
 {
     QString pubkeypath = currentPath + "/QR-pubKey" + strCount + ".txt";
@@ -443,7 +503,7 @@ void QRServer::decompressKeytowalletAddr(QString strCount)
         }
 
         disconnect(&global_port,&QSerialPort::readyRead,this,nullptr);
-        global_port.close();
+        closeGlobalPort();
     });
 }
 
@@ -474,13 +534,7 @@ void QRServer::tcpConnected()
         return;
     }
 
-    if (randomTimer) {
-        randomTimer->stop();
-    }
-
-    if (drbgTimer) {
-        drbgTimer->stop();
-    }
+    stopRandom();
 
     m_TcpSocket->connectToHost(QHostAddress(vqrServerIP),vqrServerPort);
 
@@ -497,12 +551,7 @@ void QRServer::tcpConnected()
 
         loginVqr();
 
-        if (randomTimer) {
-            randomTimer->start();
-        }
-        else{
-            getRandom();
-        }
+        startRandom();
     }
     else {
         qDebug()<<QString("连接失败 %1").arg(m_TcpSocket->errorString());
@@ -526,12 +575,7 @@ void QRServer::handleTcpSocketDisconnect()
         if (connectTimer) {
         connectTimer->start();
         }
-        if (randomTimer) {
-            randomTimer->stop();
-        }
-        if (drbgTimer) {
-            drbgTimer->stop();
-        }
+        stopRandom();
     }
 }
 
@@ -631,12 +675,7 @@ void QRServer::processReceivedData(const QByteArray &data) {
             return;
         }else if(jsonObjreceiveTCPDataheader["messageName"].toString()=="luckyWallet")
         {
-            if (randomTimer) {
-                randomTimer->stop();
-            }
-            if (drbgTimer) {
-                drbgTimer->stop();
-            }
+            stopRandom();
             if (endTimer) {
                 endTimer->stop();
             }
@@ -667,7 +706,7 @@ void QRServer::processReceivedData(const QByteArray &data) {
             endTimer->start();
             qDebug()<<"距离摇号开始："<<secondDifference<<"秒，启动定时器，参与摇号";
 
-            randomTimer->start();
+            startRandom();
             qDebug()<<"开始补充随机数";
 
             return;
@@ -721,20 +760,29 @@ void QRServer::getRandom()
 
     connect(randomTimer,&QTimer::timeout,[=]()mutable{
         QVector<int> processedNumbers = readProcessedFileNumbers(StatusPath);
-        auto intNo = processedNumbers.begin();
-        // 检查迭代器是否到达了processedNumbers的末尾
-        if (intNo != processedNumbers.end()) {
+        if (!processedNumbers.isEmpty()) {
             getallrandom = false;
             randomTimer->stop();
-            QString strkeyNo = QString::number(*intNo); // 使用当前编号
-            n_drbgrandomPath = currentPath + "/QR-drbgaesrandom" + strkeyNo + ".txt";
-            n_drbgrandomhashPath = currentPath + "/QR-drbgaesrandomhash" + strkeyNo + ".txt";
+            //空闲的生产者各领一个编号,完成后在onRandomProduced中继续
+            for (int fileNumber : processedNumbers) {
+                if (idleRandomWorkers.isEmpty() || randomProducing.size() >= randomWorkerLimit) {
+                    break;
+                }
+                if (randomProducing.contains(fileNumber)) {
+                    continue;
+                }
+                QString strkeyNo = QString::number(fileNumber); // 使用当前编号
+                QString drbgrandompath = currentPath + "/QR-drbgaesrandom" + strkeyNo + ".txt";
 
-            getDrbgRandom();
+                RandomWorker *worker = idleRandomWorkers.takeFirst();
+                randomProducing.insert(fileNumber);
+                QMetaObject::invokeMethod(worker, "produce", Qt::QueuedConnection,
+                                          Q_ARG(int, fileNumber),
+                                          Q_ARG(QString, drbgrandompath),
+                                          Q_ARG(qint64, static_cast<qint64>(randomFileSize)));
 
-            randomcount = *intNo;
-            qDebug() << "随机数补充"<<randomcount;
-            ++intNo;
+                qDebug() << "随机数补充"<<fileNumber;
+            }
         }else
         {
             getallrandom = true;
@@ -748,92 +796,89 @@ void QRServer::getRandom()
     });
 }
 
-void QRServer::getDrbgRandom()
+/**
+ * 开启随机数补充,正在生产的编号不会被重复分配
+ */
+void QRServer::startRandom()
 {
-    QString drbgrandompath = currentPath + "/QR-drbgaesrandom.txt";//drbgaesrandom路径
-    QFile drbgfile(drbgrandompath);
-    if(drbgfile.exists())
-    {
-        drbgfile.resize(0);
+    randomRunning = true;
+    for (RandomWorker *worker : randomWorkers) {
+        worker->resume();
+    }
+    if (!randomTimer) {
+        getRandom();
+        return;
+    }
+    randomTimer->start();
+}
+
+/**
+ * 停止随机数补充,正在生产的文件被放弃
+ */
+void QRServer::stopRandom()
+{
+    randomRunning = false;
+    for (RandomWorker *worker : randomWorkers) {
+        worker->cancel();
+    }
+    if (randomTimer) {
+        randomTimer->stop();
     }
+}
 
-    int loopCount = 1024; // 循环次数
-    int count = 0;
-    drbgTimer = new QTimer;
-    drbgTimer->start(0);//触发时间，单位：毫秒
+/**
+ * 生产线程完成一个随机数文件:保存哈希并更新状态
+ */
+void QRServer::onRandomProduced(int fileNumber, bool ok, const QString &hashvalue)
+{
+    RandomWorker *worker = qobject_cast<RandomWorker *>(sender());
+    if (worker) {
+        idleRandomWorkers.append(worker);
+    }
+    randomProducing.remove(fileNumber);
 
-    connect(drbgTimer,&QTimer::timeout,[=]()mutable{
-        // 如果已经执行了足够次数的操作，停止定时器
-        if (count >= loopCount) {
-            drbgTimer->stop();
-            delete drbgTimer;
-            drbgTimer = nullptr;
-
-            qDebug()<<"随机数输出完成"<<count;
-
-            QFile drbgfile(drbgrandompath);
-            QFile keydrbgfile(n_drbgrandomPath);
-            // 检查目标文件是否存在
-            if (keydrbgfile.exists()) {
-                if (keydrbgfile.remove()) {
-                    if (!drbgfile.rename(n_drbgrandomPath)) {
-                        qDebug() << "重命名失败";
-                        return;
-                    }
-                } else {
-                    qDebug() << "无法删除已存在的文件";
-                    return;
-                }
-            } else {
-                if (!drbgfile.rename(n_drbgrandomPath)) {
-                    qDebug() << "重命名失败";
-                    return;
-                }
-            }
+    if (ok) {
+        QString strkeyNo = QString::number(fileNumber);
+        QString drbgrandomhashpath = currentPath + "/QR-drbgaesrandomhash" + strkeyNo + ".txt";
+        saveHashToFile(hashvalue, drbgrandomhashpath);
+        updateFileStatus(StatusPath, fileNumber, 1);//随机数哈希状态更新为1，表示已存在
+    } else {
+        //状态仍为0,由randomTimer重新选中该编号生成
+        qDebug()<<"随机数未通过,等待重新生成随机数"<<fileNumber;
+    }
 
-            qDebug()<<"等待随机数测试";
-            testRandomFile();
-        }else{
-            QProcess DRBG;
-            DRBG.setProgram(currentPath+"/libdrbg/drbg"); // 替换为你的可执行文件路径
-
-            // 执行程序
-            DRBG.start();
-            DRBG.waitForFinished();
-            QString output = DRBG.readAllStandardOutput();
-            count++;
-        }
-    });
+    adjustRandomWorkerLimit();
+
+    if (randomRunning && randomTimer) {
+        randomTimer->start();
+    }
 }
 
-void QRServer::testRandomFile()
+/**
+ * 按熵源串口占用率调整并行生产数
+ * 串口接近满负荷时再增加生产者只会排队等熵,减少一个;有余量时逐个恢复到配置值
+ */
+void QRServer::adjustRandomWorkerLimit()
 {
-    QFile drbgfile(n_drbgrandomPath);
-    drbgfile.open(QFile::ReadWrite);
-    QByteArray arrdrbgRandom = drbgfile.readAll();
-    drbgfile.close();
-    unsigned char *rnd_data = reinterpret_cast<unsigned char *>(arrdrbgRandom.data());
-    int i = nist_randomness_evaluate(rnd_data);
-    if (i) {
-        if (drbgfile.exists()) {
-            if (drbgfile.remove()) {
-                qDebug()<<"已删除失败的随机数文件";
-            } else {
-                qDebug()<<"删除随机数文件失败";
-            }
-        }
-        qDebug()<<"随机数测试失败,等待重新生成随机数"<<randomcount;
-        getDrbgRandom();
+    qint64 elapsedUs = entropyTimer.nsecsElapsed() / 1000;
+    if (elapsedUs < 1000000) {
+        return;//至少统计1秒
     }
-    else {
-        qDebug()<<"随机数测试通过";
-        QByteArray randomHash = QCryptographicHash::hash(arrdrbgRandom, QCryptographicHash::Sha256);
-        saveHashToFile(randomHash.toHex(),n_drbgrandomhashPath);
-        updateFileStatus(StatusPath, randomcount, 1);//随机数哈希状态更新为1，表示已存在
 
-        if (randomTimer) {
-            randomTimer->start();
-        }
+    quint64 busyUs = 0;
+    if (!DrbgProducer::entropyBusyTime(busyUs)) {
+        return;
+    }
+    double usage = static_cast<double>(busyUs - entropyBusyUs) / elapsedUs;
+    entropyBusyUs = busyUs;
+    entropyTimer.restart();
+
+    if (usage > 0.9 && randomWorkerLimit > 1) {
+        randomWorkerLimit--;
+        qDebug() << "熵源占用率" << usage << ",并行生产数降为" << randomWorkerLimit;
+    } else if (usage < 0.7 && randomWorkerLimit < randomWorkerCount) {
+        randomWorkerLimit++;
+        qDebug() << "熵源占用率" << usage << ",并行生产数升为" << randomWorkerLimit;
     }
 }
 
@@ -905,7 +950,7 @@ void QRServer::hashSig()
         lotteryStart();
     }
     else{
-        if (!global_port.open(QIODevice::ReadWrite)){
+        if (!openGlobalPort()){
             qDebug() << "无法打开串口，错误：" << global_port.errorString();
             if(ledTimer){
                 ledTimer->stop();
@@ -934,7 +979,7 @@ void QRServer::hashSig()
             hashsigfile.close();
 
             disconnect(&global_port,&QSerialPort::readyRead,this,nullptr);
-            global_port.close();
+            closeGlobalPort();
             lotteryStart();
         });
     }
@@ -1012,11 +1057,7 @@ void QRServer::lotteryStart(){
     jsonObjsendTCPDatabody = QJsonObject();
     lotteryItem  = QJsonObject();
 
-    if (randomTimer) {
-        randomTimer->start();
-    }else{
-        getRandom();
-    }
+    startRandom();
 }
 
 void QRServer::onEndTimeReached()
@@ -1025,13 +1066,7 @@ void QRServer::onEndTimeReached()
     if (endTimer) {
         endTimer->stop();
     }
-    if (randomTimer) {
-        randomTimer->stop();
-    }
-    if (drbgTimer) {
-        drbgTimer->stop();
-    }
-
+    stopRandom();
     hashSig();
 }
 
@@ -1054,14 +1089,13 @@ void QRServer::lotteryResult()
                 qDebug() << "找到匹配的编号: " << strkeyNo;
                 // 读取对应编号的随机数文件内容
                 QString sigrandompath = currentPath + "/QR-drbgaesrandom" + strkeyNo + ".txt.sig";
-                QFile randomfile(sigrandompath);
-                if (randomfile.open(QIODevice::ReadOnly)) {
-                    QByteArray arrdrbgRandom = randomfile.readAll();
-                    QString strdrbgRandom = arrdrbgRandom.toHex();
-                    randomfile.close();
+                // 映射文件,每个数据包发送时只把自己那一段转成十六进制
+                QSharedPointer<MappedFile> randomfile(new MappedFile(sigrandompath));
+                if (randomfile->open()) {
+                    const qint64 packetBytes = packetSize / 2;//每字节两个十六进制字符
 
                     // 分割随机数并计算数据包数量
-                    packetCount = (strdrbgRandom.length() + packetSize - 1) / packetSize;
+                    packetCount = static_cast<int>((randomfile->size() + packetBytes - 1) / packetBytes);
 
                     // 发送数据包
                     packetTimer = new QTimer;
@@ -1069,9 +1103,7 @@ void QRServer::lotteryResult()
                     packetTimer->setInterval(0);//触发时间，单位：毫秒
                     packetTimer->start();
                     connect(packetTimer,&QTimer::timeout,[=]()mutable{
-                        int startIndex = packetNumber * packetSize;
-                        int endIndex = qMin((packetNumber + 1) * packetSize, strdrbgRandom.length());
-                        QString packetData = strdrbgRandom.mid(startIndex, endIndex - startIndex);
+                        QString packetData = randomfile->bytes(packetNumber * packetBytes, packetBytes).toHex();
 
                         jsonObjsendTCPDatabody["random"] = packetData;
                         jsonObjsendTCPDatabody["totalPackets"] = packetCount;
@@ -1196,7 +1228,7 @@ void QRServer::getWalletAddrSig()
 
 void QRServer::walletAddrSig()
 {
-    if (!global_port.open(QIODevice::ReadWrite)){
+    if (!openGlobalPort()){
         qDebug() << "无法打开串口，错误：" << global_port.errorString();
         blinkLed(0,1000,2,3);
         return;
@@ -1224,7 +1256,7 @@ void QRServer::walletAddrSig()
         walletAddrsigfile.close();
 
         disconnect(&global_port,&QSerialPort::readyRead,this,nullptr);
-        global_port.close();
+        closeGlobalPort();
     });
 }
 
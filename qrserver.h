@@ -19,21 +19,23 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QCryptographicHash>
+#include <QSharedPointer>
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
 #include <QTimer>
 #include <QTime>
+#include <QThread>
+#include <QSet>
+#include <QElapsedTimer>
 #include <wiringPi.h>
 #include <signal.h>
 #include "download.h"
 #include "checkversion.h"
 #include "globalval.h"
 #include "handleziptype.h"
+#include "randomworker.h"
 
 static const QLatin1String serviceUuid("e8e10f95-1a70-4b27-9ccf-02010264e9c8");
-extern "C" {
-int nist_randomness_evaluate(unsigned char* rnd);
-}
 class GlobalVal;
 class CheckVersion;
 class Download;
@@ -66,6 +68,7 @@ private slots:
     void tcpConnected();
 
     void onEndTimeReached();
+    void onRandomProduced(int fileNumber, bool ok, const QString &hashvalue);
 
 private:
     void openWifi();
@@ -74,9 +77,12 @@ private:
     void getWalletAddrSig();
     void addKey(QString strCount);
     void decompressKeytowalletAddr(QString strCount);
+    bool openGlobalPort();
+    void closeGlobalPort();
     void getRandom();
-    void getDrbgRandom();
-    void testRandomFile();
+    void startRandom();
+    void stopRandom();
+    void adjustRandomWorkerLimit();
     void hashSig();
     void saveHashToFile(const QString &hashvalue, const QString &hashfilepath);
     void startTcp();
@@ -115,11 +121,19 @@ private:
 
     QSerialPort global_port;
 
+    QVector<DrbgProducer *> drbgProducers;//每个编号独立的DRBG实例
+    QVector<QThread *> randomThreads;//随机数生产线程
+    QVector<RandomWorker *> randomWorkers;
+    QList<RandomWorker *> idleRandomWorkers;//空闲的生产者
+    QSet<int> randomProducing;//正在生产的编号
+    int randomWorkerCount = 1;//配置的并行生产数
+    int randomWorkerLimit = 1;//按熵源带宽调整后的并行生产数
+    quint64 entropyBusyUs = 0;
+    QElapsedTimer entropyTimer;
+
     QString currentPath = QDir::currentPath();
     QString walletAddrPath;
     QString walletAddrsigPath;
-    QString n_drbgrandomPath;
-    QString n_drbgrandomhashPath;
     QString StatusPath;
 
     QString strlotteryTime;
@@ -146,6 +160,7 @@ private:
     bool isConnect;
     bool hashfileExists;
     bool getallrandom;
+    bool randomRunning = false;//随机数补充是否开启
 
     QJsonDocument jsonDocreceiveTCPData;//收到的json格式文档
     QJsonObject jsonObjreceiveTCPData;//收到的json格式对象
@@ -158,19 +173,18 @@ private:
     QJsonArray jsonArrsendTCPDatabodylist;//发送的list数组
     QJsonObject lotteryItem;
 
-    QTimer *drbgTimer;
     QTimer *endTimer;
     QTimer *connectTimer;
-    QTimer *randomTimer;
+    QTimer *randomTimer = nullptr;
     QTimer *packetTimer;
     QTimer *waitForNextPacketTimer;
     QTimer *ledTimer;
 
-    int randomcount = 1;
     int packetCount;
     int packetNumber = 0;
     int calculateBodySize(const QJsonObject& bodyObject);//计算body字节
     const static int walletAddrCount = 10;//钱包地址数量
+    const static int randomFileSize = 1024 * 1024;//每个随机数文件的字节数
     const int packetSize = 8192 * 2; // 假设每个数据包随机数大小为8k字节
 };
 void outputLog(QtMsgType type, const QMessageLogContext &context, const QString &msg);//输出日志
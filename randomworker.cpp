@@ -0,0 +1,138 @@
+#include "randomworker.h"
+#include <QFile>
+#include <QCryptographicHash>
+#include <QDebug>
+
+/**
+ * stsBudget为NIST测试可用的内存字节数(0不限制),预算紧张时测试选用更省内存的方式
+ */
+RandomWorker::RandomWorker(const QVector<DrbgProducer *> &producers, size_t stsBudget, QObject *parent)
+    : QObject{parent}, drbgProducers(producers), stsWorkspace(sts_workspace_create(stsBudget)), canceled(0)
+{
+}
+
+RandomWorker::~RandomWorker()
+{
+    sts_workspace_free(stsWorkspace);
+}
+
+/**
+ * NIST测试内存结构创建成功才能生产,否则produce总是立即失败
+ */
+bool RandomWorker::isReady() const
+{
+    return stsWorkspace != nullptr;
+}
+
+/**
+ * 停止流水线,正在处理的文件在下一个阶段开始前放弃
+ */
+void RandomWorker::cancel()
+{
+    canceled.storeRelease(1);
+}
+
+void RandomWorker::resume()
+{
+    canceled.storeRelease(0);
+}
+
+/**
+ * 生产一个随机数文件:生成 -> 测试
+ * 生成的同时把数据喂给NIST测试和SHA256,数据只经过一遍,生成结束时哈希和前几项测试的统计已完成
+ * 哈希文件写入和状态更新由QRServer在收到randomProduced后完成
+ */
+void RandomWorker::produce(int fileNumber, const QString &randomPath, qint64 size)
+{
+    QByteArray hashvalue;
+    bool ok = false;
+
+    if (fileNumber < 1 || fileNumber > drbgProducers.size()) {
+        qDebug() << "随机数编号无效" << fileNumber;
+        emit randomProduced(fileNumber, false, QString());
+        return;
+    }
+
+    sts_ctx *sts = stsWorkspace ? sts_begin(STS_SEQUENCE_BITS, stsWorkspace) : nullptr;
+    if (!sts) {
+        qDebug() << "NIST测试内存分配失败或超出预算";
+        emit randomProduced(fileNumber, false, QString());
+        return;
+    }
+
+    DrbgProducer *drbgProducer = drbgProducers.at(fileNumber - 1);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!canceled.loadAcquire() && generateRandom(drbgProducer, randomPath, size, sts, hash)) {
+        if (canceled.loadAcquire()) {
+            qDebug() << "随机数补充已停止,放弃随机数文件" << fileNumber;
+            QFile::remove(randomPath);
+        } else {
+            ok = testRandom(randomPath, sts);
+            if (ok)
+                hashvalue = hash.result();
+            sts = nullptr;//sts_finish已释放
+        }
+    }
+    sts_free(sts);
+
+    emit randomProduced(fileNumber, ok, QString::fromLatin1(hashvalue.toHex()));
+}
+
+/**
+ * 生成随机数到临时文件,完成后替换randomPath
+ * 临时文件按编号区分,避免并行生产时互相覆盖
+ */
+bool RandomWorker::generateRandom(DrbgProducer *drbgProducer, const QString &randomPath, qint64 size, sts_ctx *sts, QCryptographicHash &hash)
+{
+    QString drbgrandompath = randomPath + ".tmp";
+
+    auto feedChunk = [sts, &hash](const unsigned char *data, int len) {
+        sts_feed(sts, data, len);
+        hash.addData(reinterpret_cast<const char *>(data), len);
+    };
+    if (!drbgProducer->generateToFile(drbgrandompath, size, feedChunk)) {
+        qDebug() << "随机数生成失败,等待下次补充";
+        QFile::remove(drbgrandompath);
+        return false;
+    }
+    qDebug()<<"随机数输出完成"<<size;
+
+    QFile drbgfile(drbgrandompath);
+    QFile keydrbgfile(randomPath);
+    // 检查目标文件是否存在
+    if (keydrbgfile.exists() && !keydrbgfile.remove()) {
+        qDebug() << "无法删除已存在的文件";
+        return false;
+    }
+    if (!drbgfile.rename(randomPath)) {
+        qDebug() << "重命名失败";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 完成NIST测试(sts在此释放),失败则删除随机数文件
+ */
+bool RandomWorker::testRandom(const QString &randomPath, sts_ctx *sts)
+{
+    QFile drbgfile(randomPath);
+
+    qDebug()<<"等待随机数测试";
+    sts_report report;
+    if (sts_finish(sts, &report)) {
+        if (report.failed == STS_ERROR)
+            qDebug() << "NIST测试数据不足";
+        else
+            qDebug() << "NIST测试未通过,第" << report.failed << "项 p =" << report.p_value[report.failed];
+        if (drbgfile.remove()) {
+            qDebug()<<"已删除失败的随机数文件";
+        } else {
+            qDebug()<<"删除随机数文件失败";
+        }
+        return false;
+    }
+
+    qDebug()<<"随机数测试通过";
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef RANDOMWORKER_H
+#define RANDOMWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+#include <QVector>
+#include <QCryptographicHash>
+#include "drbgproducer.h"
+#include "sts.h"
+
+/**
+ * 随机数生产流水线,运行在独立线程中
+ * 生成(同时喂给NIST测试和SHA256) -> NIST测试收尾,结果通过信号(跨线程为队列连接)交回QRServer更新状态
+ * 每个编号使用各自的DRBG实例,多个RandomWorker可并行生产不同编号
+ */
+class RandomWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RandomWorker(const QVector<DrbgProducer *> &producers, size_t stsBudget = 0, QObject *parent = nullptr);
+    ~RandomWorker();
+
+    bool isReady() const;
+    void cancel();//可从其他线程调用
+    void resume();
+
+public slots:
+    void produce(int fileNumber, const QString &randomPath, qint64 size);
+
+signals:
+    void randomProduced(int fileNumber, bool ok, const QString &hashvalue);
+
+private:
+    bool generateRandom(DrbgProducer *drbgProducer, const QString &randomPath, qint64 size, sts_ctx *sts, QCryptographicHash &hash);
+    bool testRandom(const QString &randomPath, sts_ctx *sts);
+
+    QVector<DrbgProducer *> drbgProducers;//下标为编号-1,由QRServer持有
+    sts_workspace *stsWorkspace;//NIST测试内存,每个文件复用
+    QAtomicInt canceled;
+};
+
+#endif // RANDOMWORKER_H
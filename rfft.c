@@ -0,0 +1,188 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "sts.h"
+#include <pthread.h>
+
+/*
+ * Real FFT for the spectral test. A sequence of n = 2 * 4^k bits is
+ * transformed as n/2 complex points (even bits real, odd bits imaginary) by
+ * radix-4 decimation-in-time stages, then split into the real transform.
+ * Plans (two small twiddle tables) are built once per n and kept for the
+ * life of the process, shared read-only by all threads. The transform runs
+ * in a caller-supplied work area of rfft_work_size() bytes. Other lengths
+ * are left to dfft.c.
+ */
+
+#define WORD_BITS			64
+#define RFFT_BLOCK			16384		/* points transformed in cache before the last stages */
+#define RFFT_SPLIT_BITS		10			/* twiddles W_n^k = W_n^(k - k % 2^10) * W_n^(k % 2^10) */
+
+typedef struct rfft_plan {
+    int n;
+    int N;							/* complex points, n / 2 */
+    int digits;						/* N = 4^digits */
+    int block;						/* 4^block_digits */
+    int block_digits;
+    double* sr_lo, * si_lo;			/* W_n^k = exp(-2 pi i k / n) for k < 2^RFFT_SPLIT_BITS */
+    double* sr_hi, * si_hi;			/* W_n^(k << RFFT_SPLIT_BITS) for k <= N >> RFFT_SPLIT_BITS */
+    struct rfft_plan* next;
+} rfft_plan;
+
+static unsigned char rfft_rev[256];	/* base-4 digit reversal of a byte */
+
+static rfft_plan* rfft_plans = NULL;
+static pthread_mutex_t rfft_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* rfft_alloc(size_t size)
+{
+    void* ptr;
+
+    if (posix_memalign(&ptr, 64, size))
+        return NULL;
+    return ptr;
+}
+
+/* j < 4^digits with its base-4 digits reversed */
+static int rfft_reverse(int j, int digits)
+{
+    uint32_t x = (uint32_t)j;
+
+    if (digits == 0)
+        return 0;
+    x = ((uint32_t)rfft_rev[x & 0xff] << 24) | ((uint32_t)rfft_rev[(x >> 8) & 0xff] << 16) |
+        ((uint32_t)rfft_rev[(x >> 16) & 0xff] << 8) | rfft_rev[x >> 24];
+    return (int)(x >> (32 - 2 * digits));
+}
+
+/* W_n^k for k <= N; the stage twiddles are W_N^j = W_n^(2j) */
+static void rfft_twiddle(const rfft_plan* p, int k, double* c, double* s)
+{
+    int hi = k >> RFFT_SPLIT_BITS, lo = k & ((1 << RFFT_SPLIT_BITS) - 1);
+
+    *c = p->sr_hi[hi] * p->sr_lo[lo] - p->si_hi[hi] * p->si_lo[lo];
+    *s = p->sr_hi[hi] * p->si_lo[lo] + p->si_hi[hi] * p->sr_lo[lo];
+}
+
+static void rfft_plan_free(rfft_plan* p)
+{
+    free(p->sr_lo);
+    free(p->si_lo);
+    free(p->sr_hi);
+    free(p->si_hi);
+    free(p);
+}
+
+static rfft_plan* rfft_plan_create(int n)
+{
+    rfft_plan* p;
+    int		j, d, N = n / 2, nhi;
+    double	pi2 = 6.28318530717958647692528676655900577;
+
+    if ((p = (rfft_plan*)calloc(1, sizeof(rfft_plan))) == NULL)
+        return NULL;
+    p->n = n;
+    p->N = N;
+    for (p->digits = 0; (1 << (2 * p->digits)) < N; p->digits++)
+        ;
+    p->block = MIN(N, RFFT_BLOCK);
+    for (p->block_digits = 0; (1 << (2 * p->block_digits)) < p->block; p->block_digits++)
+        ;
+
+    nhi = (N >> RFFT_SPLIT_BITS) + 1;
+    if (((p->sr_lo = (double*)malloc((1 << RFFT_SPLIT_BITS) * sizeof(double))) == NULL) ||
+        ((p->si_lo = (double*)malloc((1 << RFFT_SPLIT_BITS) * sizeof(double))) == NULL) ||
+        ((p->sr_hi = (double*)malloc(nhi * sizeof(double))) == NULL) ||
+        ((p->si_hi = (double*)malloc(nhi * sizeof(double))) == NULL)) {
+        rfft_plan_free(p);
+        return NULL;
+    }
+
+    for (j = 0; j < (1 << RFFT_SPLIT_BITS); j++) {
+        p->sr_lo[j] = cos(pi2 * j / n);
+        p->si_lo[j] = -sin(pi2 * j / n);
+    }
+    for (j = 0; j < nhi; j++) {
+        p->sr_hi[j] = cos(pi2 * ((double)j * (1 << RFFT_SPLIT_BITS)) / n);
+        p->si_hi[j] = -sin(pi2 * ((double)j * (1 << RFFT_SPLIT_BITS)) / n);
+    }
+    for (j = 0; rfft_rev[255] == 0 && j < 256; j++) {		/* once, before the first plan is handed out */
+        for (d = 0; d < 4; d++)
+            rfft_rev[j] |= ((j >> (2 * d)) & 3) << (2 * (3 - d));
+    }
+    return p;
+}
+
+static int rfft_supported(int n)
+{
+    int N = n / 2;
+
+    return n > 0 && n % 2 == 0 && N >= 16 && (N & (N - 1)) == 0 && __builtin_ctz(N) % 2 == 0;
+}
+
+/* the cached plan for n bits, NULL if n is not 2 * 4^k (k >= 2) or without memory */
+static const rfft_plan* rfft_plan_get(int n)
+{
+    rfft_plan* p;
+
+    if (!rfft_supported(n))
+        return NULL;
+
+    pthread_mutex_lock(&rfft_lock);
+    for (p = rfft_plans; p != NULL; p = p->next) {
+        if (p->n == n)
+            break;
+    }
+    if (p == NULL && (p = rfft_plan_create(n)) != NULL) {
+        p->next = rfft_plans;
+        rfft_plans = p;
+    }
+    pthread_mutex_unlock(&rfft_lock);
+    return p;
+}
+
+#define RFFT_REAL		double
+#define RFFT_NAME(x)	rfft_d_##x
+#include "rfft_impl.h"
+#undef RFFT_REAL
+#undef RFFT_NAME
+
+#define RFFT_REAL		float
+#define RFFT_NAME(x)	rfft_f_##x
+#include "rfft_impl.h"
+#undef RFFT_REAL
+#undef RFFT_NAME
+
+size_t rfft_work_size(int n, int single)
+{
+    if (!rfft_supported(n))
+        return 0;
+    return (size_t)n * (single ? sizeof(float) : sizeof(double));
+}
+
+int rfft_count_below(int n, const BitWord* seq, double bound, void* work)
+{
+    const rfft_plan* p = rfft_plan_get(n);
+    void	* buf = work;
+    int		count;
+
+    if (p == NULL || (buf == NULL && (buf = rfft_alloc(rfft_work_size(n, 0))) == NULL))
+        return -1;
+    count = rfft_d_count_below(p, seq, bound, (double*)buf);
+    if (work == NULL)
+        free(buf);
+    return count;
+}
+
+int rfft_count_below_f(int n, const BitWord* seq, double bound, void* work)
+{
+    const rfft_plan* p = rfft_plan_get(n);
+    void	* buf = work;
+    int		count;
+
+    if (p == NULL || (buf == NULL && (buf = rfft_alloc(rfft_work_size(n, 1))) == NULL))
+        return -1;
+    count = rfft_f_count_below(p, seq, bound, (float*)buf);
+    if (work == NULL)
+        free(buf);
+    return count;
+}
@@ -0,0 +1,184 @@
+/*
+ * Radix-4 FFT stages and the real-input post-processing of rfft.c, written
+ * once for both precisions: rfft.c includes this file with RFFT_REAL set to
+ * double and to float. The arrays are split into real and imaginary parts
+ * and the butterflies work on RFFT_LANES consecutive points at a time with
+ * GCC vector types (SSE2 on x86, NEON on ARM).
+ */
+
+#define RFFT_VEC	RFFT_NAME(vec)
+typedef RFFT_REAL	RFFT_VEC __attribute__((vector_size(16)));
+#define RFFT_LANES	((int)(sizeof(RFFT_VEC) / sizeof(RFFT_REAL)))
+
+/*
+ * Block j0 of the input in base-4 digit-reversed order: point j holds
+ * z[rev(j)] = x[2 rev(j)] + i x[2 rev(j) + 1] with x = 2 * bit - 1. For
+ * j = j0 + lo, rev(j) = rev(lo) * N/block + rev(j0 / block), so the source
+ * points are read in increasing order and scattered within the block.
+ */
+static void RFFT_NAME(gather)(const rfft_plan* p, const BitWord* seq, RFFT_REAL* re, RFFT_REAL* im, int j0)
+{
+    int		m, r, lo, stride = p->N / p->block;
+    unsigned int	pair;
+
+    r = rfft_reverse(j0 / p->block, p->digits - p->block_digits);
+    for (m = 0; m < p->block; m++, r += stride) {
+        lo = rfft_reverse(m, p->block_digits);
+        pair = (unsigned int)(seq[r / (WORD_BITS / 2)] >> (2 * (r % (WORD_BITS / 2)))) & 3;
+        re[j0 + lo] = (RFFT_REAL)(2 * (int)(pair & 1) - 1);
+        im[j0 + lo] = (RFFT_REAL)(2 * (int)(pair >> 1) - 1);
+    }
+}
+
+/* the first stage, length 4: no twiddles */
+static void RFFT_NAME(stage4)(RFFT_REAL* re, RFFT_REAL* im, int len)
+{
+    int		g;
+    RFFT_REAL	t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+
+    for (g = 0; g < len; g += 4) {
+        t0r = re[g] + re[g + 2];
+        t0i = im[g] + im[g + 2];
+        t1r = re[g] - re[g + 2];
+        t1i = im[g] - im[g + 2];
+        t2r = re[g + 1] + re[g + 3];
+        t2i = im[g + 1] + im[g + 3];
+        t3r = re[g + 1] - re[g + 3];
+        t3i = im[g + 1] - im[g + 3];
+        re[g] = t0r + t2r;
+        im[g] = t0i + t2i;
+        re[g + 1] = t1r + t3i;
+        im[g + 1] = t1i - t3r;
+        re[g + 2] = t0r - t2r;
+        im[g + 2] = t0i - t2i;
+        re[g + 3] = t1r - t3i;
+        im[g + 3] = t1i + t3r;
+    }
+}
+
+/*
+ * A decimation-in-time stage of length L over len points: the four quarters
+ * of each group hold the transforms of the four decimated subsequences,
+ * which are combined in place, RFFT_LANES points of each quarter at a time.
+ * With b_r = W_L^(r k) * quarter_r[k]:
+ *   X[k]          = b0 + b1 + b2 + b3
+ *   X[k + L/4]    = b0 - i b1 - b2 + i b3
+ *   X[k + L/2]    = b0 - b1 + b2 - b3
+ *   X[k + 3L/4]   = b0 + i b1 - b2 - i b3
+ */
+static void RFFT_NAME(stage)(const rfft_plan* p, RFFT_REAL* re, RFFT_REAL* im, int len, int L)
+{
+    int		q = L / 4, s = p->N / L, g, k, l;
+    RFFT_VEC	w1r, w1i, w2r, w2i, w3r, w3i;
+    RFFT_VEC	a0r, a0i, a1r, a1i, a2r, a2i, a3r, a3i;
+    RFFT_VEC	b1r, b1i, b2r, b2i, b3r, b3i;
+    RFFT_VEC	t0r, t0i, t1r, t1i, t2r, t2i, t3r, t3i;
+    RFFT_REAL	* r0, * i0, cr[RFFT_LANES], ci[RFFT_LANES];
+    double	c, d;
+
+    for (g = 0; g < len; g += L) {
+        for (k = 0; k < q; k += RFFT_LANES) {
+            for (l = 0; l < RFFT_LANES; l++) {
+                rfft_twiddle(p, 2 * (k + l) * s, &c, &d);
+                cr[l] = (RFFT_REAL)c;
+                ci[l] = (RFFT_REAL)d;
+            }
+            memcpy(&w1r, cr, sizeof(w1r));
+            memcpy(&w1i, ci, sizeof(w1i));
+            w2r = w1r * w1r - w1i * w1i;
+            w2i = 2 * w1r * w1i;
+            w3r = w2r * w1r - w2i * w1i;
+            w3i = w2r * w1i + w2i * w1r;
+
+            r0 = re + g + k;
+            i0 = im + g + k;
+            a0r = *(RFFT_VEC*)(r0);
+            a0i = *(RFFT_VEC*)(i0);
+            a1r = *(RFFT_VEC*)(r0 + q);
+            a1i = *(RFFT_VEC*)(i0 + q);
+            a2r = *(RFFT_VEC*)(r0 + 2 * q);
+            a2i = *(RFFT_VEC*)(i0 + 2 * q);
+            a3r = *(RFFT_VEC*)(r0 + 3 * q);
+            a3i = *(RFFT_VEC*)(i0 + 3 * q);
+
+            b1r = a1r * w1r - a1i * w1i;
+            b1i = a1r * w1i + a1i * w1r;
+            b2r = a2r * w2r - a2i * w2i;
+            b2i = a2r * w2i + a2i * w2r;
+            b3r = a3r * w3r - a3i * w3i;
+            b3i = a3r * w3i + a3i * w3r;
+
+            t0r = a0r + b2r;
+            t0i = a0i + b2i;
+            t1r = a0r - b2r;
+            t1i = a0i - b2i;
+            t2r = b1r + b3r;
+            t2i = b1i + b3i;
+            t3r = b1r - b3r;
+            t3i = b1i - b3i;
+
+            *(RFFT_VEC*)(r0) = t0r + t2r;
+            *(RFFT_VEC*)(i0) = t0i + t2i;
+            *(RFFT_VEC*)(r0 + q) = t1r + t3i;
+            *(RFFT_VEC*)(i0 + q) = t1i - t3r;
+            *(RFFT_VEC*)(r0 + 2 * q) = t0r - t2r;
+            *(RFFT_VEC*)(i0 + 2 * q) = t0i - t2i;
+            *(RFFT_VEC*)(r0 + 3 * q) = t1r - t3i;
+            *(RFFT_VEC*)(i0 + 3 * q) = t1i + t3r;
+        }
+    }
+}
+
+/* all stages of length 4..maxL, on each block of maxL points in turn */
+static void RFFT_NAME(stages)(const rfft_plan* p, RFFT_REAL* re, RFFT_REAL* im, int len, int maxL)
+{
+    int		L;
+
+    RFFT_NAME(stage4)(re, im, len);
+    for (L = 16; L <= maxL; L *= 4)
+        RFFT_NAME(stage)(p, re, im, len, L);
+}
+
+/*
+ * Transform of the n-bit sequence in work (n reals, 64-byte aligned) and the
+ * number of k in [0, n/2) with |X[k]| < bound.
+ */
+static int RFFT_NAME(count_below)(const rfft_plan* p, const BitWord* seq, double bound, RFFT_REAL* work)
+{
+    int		N = p->N, j, k, L, count;
+    RFFT_REAL	* re = work, * im = work + N;
+    double	zr, zi, cr, ci, er, ei, or_, oi, c, s, Xr, Xi, bound2;
+
+    /* the first stages block by block while the block is in cache */
+    for (j = 0; j < N; j += p->block) {
+        RFFT_NAME(gather)(p, seq, re, im, j);
+        RFFT_NAME(stages)(p, re + j, im + j, p->block, p->block);
+    }
+    for (L = 4 * p->block; L <= N; L *= 4)
+        RFFT_NAME(stage)(p, re, im, N, L);
+
+    /*
+     * Real input: X[k] = E - i W_n^k O with E, O = (Z[k] +- conj(Z[N-k])) / 2
+     */
+    bound2 = bound * bound;
+    count = 0;
+    for (k = 0; k < N; k++) {
+        zr = re[k];
+        zi = im[k];
+        cr = re[(N - k) & (N - 1)];
+        ci = -im[(N - k) & (N - 1)];
+        er = (zr + cr) / 2;
+        ei = (zi + ci) / 2;
+        or_ = (zr - cr) / 2;
+        oi = (zi - ci) / 2;
+        rfft_twiddle(p, k, &c, &s);
+        Xr = er + (c * oi + s * or_);
+        Xi = ei - (c * or_ - s * oi);
+        if (Xr * Xr + Xi * Xi < bound2)
+            count++;
+    }
+    return count;
+}
+
+#undef RFFT_VEC
+#undef RFFT_LANES
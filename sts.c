@@ -1,62 +1,211 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include "sts.h"
+#include <pthread.h>
+#include <unistd.h>
 
-BitSequence * epsilon = NULL;
+__thread BitSequence * epsilon = NULL;	/* one sequence per testing thread */
 
-double test01Frequency(int n)
+/*
+ * The tests below whose statistic can be accumulated while the sequence is
+ * being received keep it in a small state: *_update() consumes the bits
+ * [st->pos, end) of a packed sequence and *_p_value() turns the accumulated
+ * statistic into the p-value. The whole-sequence test functions and the
+ * streaming evaluator (sts_begin/sts_feed/sts_finish) share the same code.
+ *
+ * Packed sequences hold bit i in bit i % 64 of word i / 64 and are followed
+ * by one zero word, so that 64 bits can be read from any position.
+ */
+
+#define WORD_BITS	64
+
+static inline int popcount64(uint64_t x)
 {
-    double p_value = 0;
-    int		i;
-    double	f, s_obs, sum, sqrt2 = 1.41421356237309504880;
+    return __builtin_popcountll(x);
+}
 
-    sum = 0.0;
+/* mask of the low len bits, 0 < len <= 64 */
+static inline uint64_t low_bits(int len)
+{
+    return (len < WORD_BITS) ? ((UINT64_C(1) << len) - 1) : ~UINT64_C(0);
+}
+
+/* the len bits starting at pos, which must not cross a word boundary */
+static inline uint64_t word_bits(const BitWord* w, int pos, int len)
+{
+    return (w[pos / WORD_BITS] >> (pos % WORD_BITS)) & low_bits(len);
+}
+
+/* the 64 bits starting at any pos */
+static inline uint64_t window_bits(const BitWord* w, int pos)
+{
+    int s = pos % WORD_BITS;
+    uint64_t x = w[pos / WORD_BITS] >> s;
+
+    if (s)
+        x |= w[pos / WORD_BITS + 1] << (WORD_BITS - s);
+    return x;
+}
+
+/* length of the next chunk from pos: up to the word, block or sequence end */
+static inline int chunk_bits(int pos, int end, int block)
+{
+    int len = WORD_BITS - pos % WORD_BITS;
+
+    if (block && block - pos % block < len)
+        len = block - pos % block;
+    return MIN(len, end - pos);
+}
+
+static BitWord* pack_sequence(const BitSequence* seq, int n)
+{
+    BitWord* w;
+    int i;
+
+    if ((w = (BitWord*)calloc(n / WORD_BITS + 2, sizeof(BitWord))) == NULL)
+        return NULL;
     for (i = 0; i < n; i++)
-        sum += 2 * (int)epsilon[i] - 1;
+        w[i / WORD_BITS] |= (BitWord)seq[i] << (i % WORD_BITS);
+    return w;
+}
+
+/* the testXX() functions: test i on the first n bits of epsilon */
+static double sts_test_epsilon(int i, int n)
+{
+    BitWord* w;
+    double	p_value;
+
+    if ((w = pack_sequence(epsilon, n)) == NULL)
+        return 0.0;
+    p_value = sts_test(i, w, n);
+    free(w);
+    return p_value;
+}
+
+typedef struct {
+    int pos;
+    int ones;
+} frequency_state;
+
+static void frequency_update(frequency_state* st, const BitWord* seq, int end)
+{
+    int i, len;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, 0);
+        st->ones += popcount64(word_bits(seq, i, len));
+    }
+    st->pos = end;
+}
+
+static double frequency_p_value(const frequency_state* st, int n)
+{
+    double	f, s_obs, sum, sqrt2 = 1.41421356237309504880;
+
+    sum = 2.0 * st->ones - n;
     s_obs = fabs(sum) / sqrt(n);
     f = s_obs / sqrt2;
-    p_value = erfc(f);
-    return p_value;
+    return erfc(f);
 }
 
-double test02BlockFrequency(int n)
+double test01Frequency(int n)
 {
-    int M = 128;
+    return sts_test_epsilon(1, n);
+}
 
-    int		i, j, N, blockSum;
-    double	p_value, sum, pi, v, chi_squared;
+#define BLOCK_FREQUENCY_M	128
 
-    N = n / M; 		/* # OF SUBSTRING BLOCKS      */
-    sum = 0.0;
+typedef struct {
+    int pos;
+    int blockSum;
+    double sum;
+} block_frequency_state;
 
-    for (i = 0; i < N; i++) {
-        blockSum = 0;
-        for (j = 0; j < M; j++)
-            blockSum += epsilon[j + i * M];
-        pi = (double)blockSum / (double)M;
-        v = pi - 0.5;
-        sum += v * v;
-    }
-    chi_squared = 4.0 * M * sum;
-    p_value = cephes_igamc(N / 2.0, chi_squared / 2.0);
-    return p_value;
+static void block_frequency_update(block_frequency_state* st, const BitWord* seq, int end)
+{
+    int i, len;
+    double pi, v;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, BLOCK_FREQUENCY_M);
+        st->blockSum += popcount64(word_bits(seq, i, len));
+        if ((i + len) % BLOCK_FREQUENCY_M == 0) {
+            pi = (double)st->blockSum / (double)BLOCK_FREQUENCY_M;
+            v = pi - 0.5;
+            st->sum += v * v;
+            st->blockSum = 0;
+        }
+    }
+    st->pos = end;
 }
 
-double test03CumulativeSums(int n)
+static double block_frequency_p_value(const block_frequency_state* st, int n)
 {
-    int		S, sup, inf, z, zrev, k;
-    double	sum1, sum2, p_value;
+    int M = BLOCK_FREQUENCY_M;
+    int N = n / M; 		/* # OF SUBSTRING BLOCKS      */
+    double chi_squared;
 
-    S = 0;
-    sup = 0;
-    inf = 0;
-    for (k = 0; k < n; k++) {
-        epsilon[k] ? S++ : S--;
-        if (S > sup)
-            sup++;
-        if (S < inf)
-            inf--;
-        z = (sup > -inf) ? sup : -inf;
-        zrev = (sup - S > S - inf) ? sup - S : S - inf;
+    chi_squared = 4.0 * M * st->sum;
+    return cephes_igamc(N / 2.0, chi_squared / 2.0);
+}
+
+double test02BlockFrequency(int n)
+{
+    return sts_test_epsilon(2, n);
+}
+
+typedef struct {
+    int pos;
+    int S, sup, inf;
+    signed char step[256], high[256], low[256];	/* per byte: walk, max and min partial sum */
+} cusum_state;
+
+static void cusum_init(cusum_state* st)
+{
+    int b, j, S;
+
+    memset(st, 0, sizeof(*st));
+    for (b = 0; b < 256; b++) {
+        S = 0;
+        st->high[b] = -8;
+        st->low[b] = 8;
+        for (j = 0; j < 8; j++) {
+            ((b >> j) & 1) ? S++ : S--;
+            st->high[b] = MAX(st->high[b], S);
+            st->low[b] = MIN(st->low[b], S);
+        }
+        st->step[b] = S;
     }
+}
+
+static void cusum_update(cusum_state* st, const BitWord* seq, int end)
+{
+    int i, len, b;
+    uint64_t x;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, 0);
+        x = word_bits(seq, i, len);
+        for (b = len; b >= 8; b -= 8, x >>= 8) {
+            st->sup = MAX(st->sup, st->S + st->high[x & 0xff]);
+            st->inf = MIN(st->inf, st->S + st->low[x & 0xff]);
+            st->S += st->step[x & 0xff];
+        }
+        for (; b > 0; b--, x >>= 1) {
+            (x & 1) ? st->S++ : st->S--;
+            st->sup = MAX(st->sup, st->S);
+            st->inf = MIN(st->inf, st->S);
+        }
+    }
+    st->pos = end;
+}
+static double cusum_p_value(const cusum_state* st, int n)
+{
+    int		z, zrev, k;
+    double	sum1, sum2, p_value;
+
+    z = (st->sup > -st->inf) ? st->sup : -st->inf;
+    zrev = (st->sup - st->S > st->S - st->inf) ? st->sup - st->S : st->S - st->inf;
 
     // forward
     sum1 = 0.0;
@@ -88,111 +237,198 @@ double test03CumulativeSums(int n)
     return p_value;
 }
 
-double test04Runs(int n)
+double test03CumulativeSums(int n)
+{
+    return sts_test_epsilon(3, n);
+}
+
+typedef struct {
+    int pos;
+    int S;
+    int V;
+    int last;
+} runs_state;
+
+static void runs_update(runs_state* st, const BitWord* seq, int end)
 {
-    int		S, k;
-    double	pi, V, erfc_arg, p_value;
+    int i, len;
+    uint64_t x;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, 0);
+        x = word_bits(seq, i, len);
+        st->S += popcount64(x);
+        /* a run ends wherever a bit differs from the next one */
+        st->V += popcount64((x ^ (x >> 1)) & (low_bits(len) >> 1));
+        if (i > 0 && (int)(x & 1) != st->last)
+            st->V++;
+        st->last = (int)(x >> (len - 1)) & 1;
+    }
+    st->pos = end;
+}
+static double runs_p_value(const runs_state* st, int n)
+{
+    double	pi, erfc_arg, p_value;
 
-    S = 0;
-    for (k = 0; k < n; k++)
-        if (epsilon[k])
-            S++;
-    pi = (double)S / (double)n;
+    pi = (double)st->S / (double)n;
 
     if (fabs(pi - 0.5) > (2.0 / sqrt(n))) {
         p_value = 0.0;
     }
     else {
-        V = 1;
-        for (k = 1; k < n; k++)
-            if (epsilon[k] != epsilon[k - 1])
-                V++;
-        erfc_arg = fabs(V - 2.0 * n * pi * (1 - pi)) / (2.0 * pi * (1 - pi) * sqrt(2 * n));
+        erfc_arg = fabs(st->V - 2.0 * n * pi * (1 - pi)) / (2.0 * pi * (1 - pi) * sqrt(2 * n));
         p_value = erfc(erfc_arg);
     }
     return p_value;
 }
 
-double test05LongestRunOfOnes(int n)
+double test04Runs(int n)
 {
-    double			pval, chi2, pi[7];
-    int				run, v_n_obs, N, i, j, K, M, V[7];
-    unsigned int	nu[7] = { 0, 0, 0, 0, 0, 0, 0 };
+    return sts_test_epsilon(4, n);
+}
 
-    if (n < 128) {
-        return 0.0;
-    }
+typedef struct {
+    int pos;
+    int K, M;
+    int V[7];
+    double pi[7];
+    int run, v_n_obs;
+    unsigned int nu[7];
+} longest_run_state;
+
+static void longest_run_init(longest_run_state* st, int n)
+{
+    memset(st, 0, sizeof(*st));
     if (n < 6272) {
-        K = 3;
-        M = 8;
-        V[0] = 1; V[1] = 2; V[2] = 3; V[3] = 4;
-        pi[0] = 0.21484375;
-        pi[1] = 0.3671875;
-        pi[2] = 0.23046875;
-        pi[3] = 0.1875;
+        st->K = 3;
+        st->M = 8;
+        st->V[0] = 1; st->V[1] = 2; st->V[2] = 3; st->V[3] = 4;
+        st->pi[0] = 0.21484375;
+        st->pi[1] = 0.3671875;
+        st->pi[2] = 0.23046875;
+        st->pi[3] = 0.1875;
     }
     else if (n < 750000) {
-        K = 5;
-        M = 128;
-        V[0] = 4; V[1] = 5; V[2] = 6; V[3] = 7; V[4] = 8; V[5] = 9;
-        pi[0] = 0.1174035788;
-        pi[1] = 0.242955959;
-        pi[2] = 0.249363483;
-        pi[3] = 0.17517706;
-        pi[4] = 0.102701071;
-        pi[5] = 0.112398847;
+        st->K = 5;
+        st->M = 128;
+        st->V[0] = 4; st->V[1] = 5; st->V[2] = 6; st->V[3] = 7; st->V[4] = 8; st->V[5] = 9;
+        st->pi[0] = 0.1174035788;
+        st->pi[1] = 0.242955959;
+        st->pi[2] = 0.249363483;
+        st->pi[3] = 0.17517706;
+        st->pi[4] = 0.102701071;
+        st->pi[5] = 0.112398847;
     }
     else {
-        K = 6;
-        M = 10000;
-        V[0] = 10; V[1] = 11; V[2] = 12; V[3] = 13; V[4] = 14; V[5] = 15; V[6] = 16;
-        pi[0] = 0.0882;
-        pi[1] = 0.2092;
-        pi[2] = 0.2483;
-        pi[3] = 0.1933;
-        pi[4] = 0.1208;
-        pi[5] = 0.0675;
-        pi[6] = 0.0727;
+        st->K = 6;
+        st->M = 10000;
+        st->V[0] = 10; st->V[1] = 11; st->V[2] = 12; st->V[3] = 13; st->V[4] = 14; st->V[5] = 15; st->V[6] = 16;
+        st->pi[0] = 0.0882;
+        st->pi[1] = 0.2092;
+        st->pi[2] = 0.2483;
+        st->pi[3] = 0.1933;
+        st->pi[4] = 0.1208;
+        st->pi[5] = 0.0675;
+        st->pi[6] = 0.0727;
     }
+}
 
-    N = n / M;
-    for (i = 0; i < N; i++) {
-        v_n_obs = 0;
-        run = 0;
-        for (j = 0; j < M; j++) {
-            if (epsilon[i * M + j] == 1) {
-                run++;
-                if (run > v_n_obs)
-                    v_n_obs = run;
-            }
-            else
-                run = 0;
+static void longest_run_block_end(longest_run_state* st)
+{
+    int j;
+
+    if (st->v_n_obs < st->V[0])
+        st->nu[0]++;
+    for (j = 0; j <= st->K; j++) {
+        if (st->v_n_obs == st->V[j])
+            st->nu[j]++;
+    }
+    if (st->v_n_obs > st->V[st->K])
+        st->nu[st->K]++;
+    st->v_n_obs = 0;
+    st->run = 0;
+}
+
+static void longest_run_update(longest_run_state* st, const BitWord* seq, int end)
+{
+    int i, len, k;
+    uint64_t x, y;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, st->M);
+        x = word_bits(seq, i, len);
+        if (x == low_bits(len)) {
+            st->run += len;
         }
-        if (v_n_obs < V[0])
-            nu[0]++;
-        for (j = 0; j <= K; j++) {
-            if (v_n_obs == V[j])
-                nu[j]++;
+        else {
+            /* ones continuing the previous run, then the longest run inside */
+            st->run += __builtin_ctzll(~x);
+            st->v_n_obs = MAX(st->v_n_obs, st->run);
+            for (k = 0, y = x; y; k++)
+                y &= y >> 1;
+            st->v_n_obs = MAX(st->v_n_obs, k);
+            /* ones at the end of the chunk start the next run */
+            st->run = len - 1 - (63 - __builtin_clzll(~x & low_bits(len)));
         }
-        if (v_n_obs > V[K])
-            nu[K]++;
+        st->v_n_obs = MAX(st->v_n_obs, st->run);
+        if ((i + len) % st->M == 0)		/* END OF BLOCK */
+            longest_run_block_end(st);
     }
+    st->pos = end;
+}
 
+static double longest_run_p_value(const longest_run_state* st, int n)
+{
+    double	chi2;
+    int		i, N, K = st->K;
+
+    if (n < 128) {
+        return 0.0;
+    }
+
+    N = n / st->M;
     chi2 = 0.0;
     for (i = 0; i <= K; i++)
-        chi2 += ((nu[i] - N * pi[i]) * (nu[i] - N * pi[i])) / (N * pi[i]);
+        chi2 += ((st->nu[i] - N * st->pi[i]) * (st->nu[i] - N * st->pi[i])) / (N * st->pi[i]);
 
-    pval = cephes_igamc((double)(K / 2.0), chi2 / 2.0);
-    return pval;
+    return cephes_igamc((double)(K / 2.0), chi2 / 2.0);
 }
 
-double test06Rank(int n)
+double test05LongestRunOfOnes(int n)
+{
+    return sts_test_epsilon(5, n);
+}
+
+#define RANK_BITS	(32 * 32)
+
+typedef struct {
+    int pos;		/* always a multiple of RANK_BITS */
+    int F_32, F_31;
+} rank_state;
+
+static void rank_update(rank_state* st, const BitWord* seq, int end)
 {
-    int			N, i, k, r;
-    double		p_value, product, chi_squared, arg1, p_32, p_31, p_30, R, F_32, F_31, F_30;
-    BitSequence** matrix = create_matrix(32, 32);
+    int			i, k, R;
+    uint32_t	rows[32];
+
+    for (k = st->pos / RANK_BITS; (k + 1) * RANK_BITS <= end; k++) {	/* FOR EACH 32x32 MATRIX   */
+        for (i = 0; i < 32; i++)
+            rows[i] = (uint32_t)word_bits(seq, k * RANK_BITS + i * 32, 32);
+        R = computeRank32(rows);
+        if (R == 32)
+            st->F_32++;			/* DETERMINE FREQUENCIES */
+        if (R == 31)
+            st->F_31++;
+    }
+    st->pos = k * RANK_BITS;
+}
 
-    N = n / (32 * 32);
+static double rank_p_value(const rank_state* st, int n)
+{
+    int			N, i, r;
+    double		p_value, product, chi_squared, arg1, p_32, p_31, p_30, F_32, F_31, F_30;
+
+    N = n / RANK_BITS;
     if (isZero(N)) {
         p_value = 0.00;
     }
@@ -211,19 +447,8 @@ double test06Rank(int n)
 
         p_30 = 1 - (p_32 + p_31);
 
-        F_32 = 0;
-        F_31 = 0;
-        for (k = 0; k < N; k++) {			/* FOR EACH 32x32 MATRIX   */
-            def_matrix(32, 32, matrix, k);
-#if 0
-            display_matrix(32, 32, matrix);
-#endif
-            R = computeRank(32, 32, matrix);
-            if (R == 32)
-                F_32++;			/* DETERMINE FREQUENCIES */
-            if (R == 31)
-                F_31++;
-        }
+        F_32 = st->F_32;
+        F_31 = st->F_31;
         F_30 = (double)N - (F_32 + F_31);
 
         chi_squared = (pow(F_32 - N * p_32, 2) / (double)(N * p_32) +
@@ -233,34 +458,51 @@ double test06Rank(int n)
         arg1 = -chi_squared / 2.e0;
 
         p_value = exp(arg1);
-        for (i = 0; i < 32; i++)				/* DEALLOCATE MATRIX  */
-            free(matrix[i]);
-        free(matrix);
     }
     return p_value;
 }
 
+double test06Rank(int n)
+{
+    return sts_test_epsilon(6, n);
+}
+
 void  __ogg_fdrffti(int n, double* wsave, int* ifac);
 void  __ogg_fdrfftf(int n, double* X, double* wsave, int* ifac);
 
-double test07DiscreteFourierTransform(int n)
+#ifdef STS_DFT_SINGLE
+#define DFT_SINGLE		1
+#else
+#define DFT_SINGLE		0
+#endif
+
+/* X[n + 1], wsave[2 * n] and m[n / 2 + 1] of the mixed-radix transform */
+#define DFT_FALLBACK_SIZE(n)	(((size_t)(n) + 1 + 2 * (size_t)(n) + (n) / 2 + 1) * sizeof(double))
+
+/* bytes of the work area dft_p_value() uses for n bits */
+static size_t dft_work_size(int n, int single)
 {
-    double	p_value, upperBound, percentile, N_l, N_o, d, * m = NULL, * X = NULL, * wsave = NULL;
+    size_t size = rfft_work_size(n, single);
+
+    return size ? size : DFT_FALLBACK_SIZE(n);
+}
+
+/*
+ * |X[k]| < bound for k < n/2 by the mixed-radix dfft.c, any n; work is
+ * DFT_FALLBACK_SIZE(n) bytes or NULL. -1 without memory.
+ */
+static int dft_count_below(const BitWord* seq, int n, double bound, void* work)
+{
+    double	* m, * X, * wsave;
     int		i, count, ifac[15];
 
-    if (((X = (double*)calloc(n, sizeof(double))) == NULL) ||
-        ((wsave = (double*)calloc(2 * n, sizeof(double))) == NULL) ||
-        ((m = (double*)calloc(n / 2 + 1, sizeof(double))) == NULL)) {
-        if (X != NULL)
-            free(X);
-        if (wsave != NULL)
-            free(wsave);
-        if (m != NULL)
-            free(m);
-        return 0;
-    }
+    if ((X = (double*)work) == NULL && (X = (double*)malloc(DFT_FALLBACK_SIZE(n))) == NULL)
+        return -1;
+    wsave = X + n + 1;
+    m = wsave + 2 * n;
+    memset(X, 0, (n + 1 + 2 * n) * sizeof(double));		/* X[n] IS READ AS 0 BELOW */
     for (i = 0; i < n; i++)
-        X[i] = 2 * (int)epsilon[i] - 1;
+        X[i] = 2 * (int)word_bits(seq, i, 1) - 1;
 
     __ogg_fdrffti(n, wsave, ifac);		/* INITIALIZE WORK ARRAYS */
     __ogg_fdrfftf(n, X, wsave, ifac);	/* APPLY FORWARD FFT */
@@ -269,155 +511,137 @@ double test07DiscreteFourierTransform(int n)
 
     for (i = 0; i < n / 2; i++)
         m[i + 1] = sqrt(pow(X[2 * i + 1], 2) + pow(X[2 * i + 2], 2));
-    count = 0;				       /* CONFIDENCE INTERVAL */
-    upperBound = sqrt(2.995732274 * n);
+    count = 0;
     for (i = 0; i < n / 2; i++)
-        if (m[i] < upperBound)
+        if (m[i] < bound)
             count++;
+
+    if (work == NULL)
+        free(X);
+    return count;
+}
+
+/*
+ * Lengths of 2 * 4^k bits (the 8M-bit files among them) go through the cached
+ * radix-4 plans of rfft.c, in double or single precision. work is
+ * dft_work_size(n, single) bytes, 64-byte aligned, or NULL.
+ */
+static double dft_p_value(const BitWord* seq, int n, int single, void* work)
+{
+    double	p_value, upperBound, percentile, N_l, N_o, d;
+    int		count;
+
+    upperBound = sqrt(2.995732274 * n);		/* CONFIDENCE INTERVAL */
+    if (single)
+        count = rfft_count_below_f(n, seq, upperBound, work);
+    else
+        count = rfft_count_below(n, seq, upperBound, work);
+    if (count < 0 && (work == NULL || rfft_work_size(n, single) == 0))
+        count = dft_count_below(seq, n, upperBound, work);
+    if (count < 0)
+        return 0;
     percentile = (double)count / (n / 2) * 100;
     N_l = (double)count;       /* number of peaks less than h = sqrt(3*n) */
     N_o = (double)0.95 * n / 2.0;
     d = (N_l - N_o) / sqrt(n / 4.0 * 0.95 * 0.05);
     p_value = erfc(fabs(d) / sqrt(2.0));
 
-    free(X);
-    free(wsave);
-    free(m);
-
     return p_value;
 }
 
-int is_peridic(int m, unsigned char data[])
-{
-    int i;
-    int l, n;
-
-    for (l = 1; l < m; l++) {
-        n = m / l;
-        if (memcmp(data, data + n * l, m - n * l)) {
-            continue;
-        }
-        for (i = 1; i < n; i++) {
-            if (memcmp(data, data + i * l, l)) {
-                break;
-            }
-        }
-        if (i == n) {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-int generate_template(int m, int i, unsigned char data[])
+double test07DiscreteFourierTransform(int n)
 {
-    int j;
-    for (j = 0; j < m; j++) {
-        data[j] = (i >> j) & 0x01;
-    }
-    if (!is_peridic(m, data)) {
-        return 1;
-    }
-    return 0;
+    return sts_test_epsilon(7, n);
 }
 
-
-double test08NonOverlappingTemplateMatchings(int n)
+/*
+ * The 148 aperiodic 9-bit templates, bit j of each value being template bit j
+ * (the first 148 values for which no shorter block repeats through the
+ * template).
+ */
+#define TEMPLATE_M	9
+
+static const unsigned short aperiodic_templates[MAXNUMOFTEMPLATES] = {
+      1,   3,   5,   7,   9,  11,  13,  15,  17,  19,  21,  23,
+     25,  27,  29,  31,  35,  37,  39,  41,  43,  45,  47,  51,
+     53,  55,  57,  59,  61,  63,  67,  69,  71,  75,  77,  79,
+     83,  85,  87,  91,  93,  95, 101, 103, 107, 109, 111, 117,
+    119, 123, 125, 127, 131, 135, 139, 143, 147, 151, 155, 159,
+    163, 167, 171, 175, 179, 183, 187, 191, 199, 207, 215, 223,
+    239, 255, 256, 272, 288, 296, 304, 312, 320, 324, 328, 332,
+    336, 340, 344, 348, 352, 356, 360, 364, 368, 372, 376, 380,
+    384, 386, 388, 392, 394, 400, 402, 404, 408, 410, 416, 418,
+    420, 424, 426, 428, 432, 434, 436, 440, 442, 444, 448, 450,
+    452, 454, 456, 458, 460, 464, 466, 468, 470, 472, 474, 476,
+    480, 482, 484, 486, 488, 490, 492, 494, 496, 498, 500, 502,
+    504, 506, 508, 510
+};
+
+/*
+ * Slides one 9-bit window over each block and counts the non-overlapping
+ * occurrences of every 9-bit pattern at once: a pattern is counted again
+ * only TEMPLATE_M positions after its previous match, which is the same as
+ * scanning the block for each template separately.
+ */
+static double non_overlapping_template_p_value(const BitWord* seq, int n)
 {
-    int m = 9;
-
-    int		numOfTemplates[100] = { 0, 0, 2, 4, 6, 12, 20, 40, 74, 148, 284, 568, 1116,
-                        2232, 4424, 8848, 17622, 35244, 70340, 140680, 281076, 562152 };
-    /*----------------------------------------------------------------------------
-    NOTE:  Should additional templates lengths beyond 21 be desired, they must
-    first be constructed, saved into files and then the corresponding
-    number of nonperiodic templates for that file be stored in the m-th
-    position in the numOfTemplates variable.
-    ----------------------------------------------------------------------------*/
-    unsigned int	W_obs, nu[6], * Wj = NULL;
-    FILE* fp = NULL;
-    double			sum, chi2, p_value, lambda, pi[6], varWj;
-    int				i, j, jj, k, kk, match, SKIP, M, N, K = 5;
-    BitSequence* sequence = NULL;
+    int m = TEMPLATE_M;
+    unsigned int	(*W)[1 << TEMPLATE_M] = NULL;
+    int				next[1 << TEMPLATE_M];
+    double			chi2, p_value, lambda, varWj;
+    int				i, j, jj, len, b, pos, M, N;
+    unsigned int	v;
+    uint64_t		x;
 
     N = 8;
     M = n / N;
 
-    if ((Wj = (unsigned int*)calloc(N, sizeof(unsigned int))) == NULL) {
-        return 0;
-    }
     lambda = (M - m + 1) / pow(2, m);
     varWj = M * (1.0 / pow(2.0, m) - (2.0 * m - 1.0) / pow(2.0, 2.0 * m));
 
-    if (((isNegative(lambda)) || (isZero(lambda))) ||
-        ((sequence = (BitSequence*)calloc(m, sizeof(BitSequence))) == NULL)) {
-        if (sequence != NULL)
-            free(sequence);
-        free(Wj);
+    if ((isNegative(lambda)) || (isZero(lambda)) ||
+        ((W = (unsigned int(*)[1 << TEMPLATE_M])calloc(N, sizeof(*W))) == NULL)) {
         return 0;
     }
 
-    if (numOfTemplates[m] < MAXNUMOFTEMPLATES)
-        SKIP = 1;
-    else
-        SKIP = (int)(numOfTemplates[m] / MAXNUMOFTEMPLATES);
-    numOfTemplates[m] = (int)numOfTemplates[m] / SKIP;
-
-    sum = 0.0;
-    for (i = 0; i < 2; i++) {                      /* Compute Probabilities */
-        pi[i] = exp(-lambda + i * log(lambda) - cephes_lgam(i + 1));
-        sum += pi[i];
-    }
-    pi[0] = sum;
-    for (i = 2; i <= K; i++) {                      /* Compute Probabilities */
-        pi[i - 1] = exp(-lambda + i * log(lambda) - cephes_lgam(i + 1));
-        sum += pi[i - 1];
-    }
-    pi[K] = 1 - sum;
-
-    kk = 0;
-    p_value = 1.0;
-    for (jj = 0; jj < MIN(MAXNUMOFTEMPLATES, numOfTemplates[m]);jj++) {
-        sum = 0;
-
-        while (kk < (1 << m)){
-            kk++;
-            if (generate_template(m, kk, sequence)) {
-                break;
-            }
-        }
-        for (k = 0; k <= K; k++)
-            nu[k] = 0;
-        for (i = 0; i < N; i++) {
-            W_obs = 0;
-            for (j = 0; j < M - m + 1; j++) {
-                match = 1;
-                for (k = 0; k < m; k++) {
-                    if ((int)sequence[k] != (int)epsilon[i * M + j + k]) {
-                        match = 0;
-                        break;
-                    }
-                }
-                if (match == 1) {
-                    W_obs++;
-                    j += m - 1;
+    for (i = 0; i < N; i++) {
+        for (v = 0; v < (1u << m); v++)
+            next[v] = 0;
+        v = 0;
+        /* v holds bits j-m+1..j of the block, the oldest in bit 0 */
+        for (j = 0; j < M; j += len) {
+            pos = i * M + j;
+            len = chunk_bits(pos, i * M + M, 0);
+            x = word_bits(seq, pos, len);
+            for (b = 0; b < len; b++, x >>= 1) {
+                v = (v >> 1) | ((unsigned int)(x & 1) << (m - 1));
+                if (j + b >= m - 1 && j + b - m + 1 >= next[v]) {
+                    W[i][v]++;
+                    next[v] = j + b + 1;
                 }
             }
-            Wj[i] = W_obs;
         }
-        sum = 0;
+    }
+
+    p_value = 1.0;
+    for (jj = 0; jj < MAXNUMOFTEMPLATES; jj++) {
+        v = aperiodic_templates[jj];
         chi2 = 0.0;                                   /* Compute Chi Square */
         for (i = 0; i < N; i++) {
-            chi2 += pow(((double)Wj[i] - lambda) / pow(varWj, 0.5), 2);
+            chi2 += pow(((double)W[i][v] - lambda) / pow(varWj, 0.5), 2);
         }
         p_value = MIN(p_value, cephes_igamc(N / 2.0, chi2 / 2.0));
     }
 
-    free(sequence);
-    free(Wj);
+    free(W);
     return p_value;
 }
 
+double test08NonOverlappingTemplateMatchings(int n)
+{
+    return sts_test_epsilon(8, n);
+}
+
 double
 Pr(int u, double eta)
 {
@@ -436,27 +660,20 @@ Pr(int u, double eta)
 }
 
 
-double test09OverlappingTemplateMatchings(int n)
+static double overlapping_template_p_value(const BitWord* seq, int n)
 {
     int m = 9;
-    int				i, k, match;
+    int				i, j, len;
     double			W_obs, eta, sum, chi2, p_value, lambda;
-    int				M, N, j, K = 5;
+    int				M, N, K = 5;
     unsigned int	nu[6] = { 0, 0, 0, 0, 0, 0 };
     //double			pi[6] = { 0.143783, 0.139430, 0.137319, 0.124314, 0.106209, 0.348945 };
     double			pi[6] = { 0.364091, 0.185659, 0.139381, 0.100571, 0.0704323, 0.139865 };
-    BitSequence* sequence;
+    uint64_t		x;
 
     M = 1032;
     N = n / M;
 
-    if ((sequence = (BitSequence*)calloc(m, sizeof(BitSequence))) == NULL) {
-        return 0;
-    }
-    else
-        for (i = 0; i < m; i++)
-            sequence[i] = 1;
-
     lambda = (double)(M - m + 1) / pow(2, m);
     eta = lambda / 2.0;
     sum = 0.0;
@@ -468,14 +685,15 @@ double test09OverlappingTemplateMatchings(int n)
 
     for (i = 0; i < N; i++) {
         W_obs = 0;
-        for (j = 0; j < M - m + 1; j++) {
-            match = 1;
-            for (k = 0; k < m; k++) {
-                if (sequence[k] != epsilon[i * M + j + k])
-                    match = 0;
-            }
-            if (match == 1)
-                W_obs++;
+        /* the template is m ones: bit j of x survives iff bits j..j+m-1 are all ones */
+        for (j = 0; j < M - m + 1; j += len) {
+            len = MIN(WORD_BITS - m + 1, M - m + 1 - j);
+            x = window_bits(seq, i * M + j);
+            x &= x >> 1;
+            x &= x >> 2;
+            x &= x >> 4;
+            x &= x >> 1;
+            W_obs += popcount64(x & low_bits(len));
         }
         if (W_obs <= 4)
             nu[(int)W_obs]++;
@@ -490,15 +708,29 @@ double test09OverlappingTemplateMatchings(int n)
     }
     p_value = cephes_igamc(K / 2.0, chi2 / 2.0);
 
-    free(sequence);
     return p_value;
 }
 
-double test10Universal(int n)
+double test09OverlappingTemplateMatchings(int n)
+{
+    return sts_test_epsilon(9, n);
+}
+
+/*
+ * Blocks are read LSB first straight from the packed words; T only maps a
+ * pattern to its last position, so the bit order of the index is irrelevant.
+ * log2 of the distances (geometric, mean 2^L) comes from a table of
+ * UNIVERSAL_LOG_TABLE * 2^L entries computed with the same expression as the
+ * rare longer distances, so the sum is unchanged.
+ */
+#define UNIVERSAL_LOG_TABLE		16
+
+static double universal_p_value(const BitWord* seq, int n)
 {
-    int		i, j, p, L, Q, K;
-    double	arg, sqrt2, sigma, phi, sum, p_value, c;
-    long* T = NULL, decRep;
+    int		i, p, L, Q, K, d, nlog;
+    double	arg, sqrt2, sigma, phi, sum, p_value, c, * lg = NULL;
+    long* T = NULL;
+    unsigned int	decRep;
     double	expected_value[17] = { 0, 0, 0, 0, 0, 0, 5.2177052, 6.1962507, 7.1836656,
                 8.1764248, 9.1723243, 10.170032, 11.168765,
                 12.168070, 13.167693, 14.167488, 15.167379 };
@@ -526,32 +758,32 @@ double test10Universal(int n)
     K = (int)(floor(n / L) - (double)Q);	 		    /* BLOCKS TO TEST */
 
     p = (int)pow(2, L);
+    nlog = UNIVERSAL_LOG_TABLE * p;
     if ((L < 6) || (L > 16) || ((double)Q < 10 * pow(2, L)) ||
-        ((T = (long*)calloc(p, sizeof(long))) == NULL)) {
+        ((T = (long*)calloc(p, sizeof(long))) == NULL) ||
+        ((lg = (double*)malloc(nlog * sizeof(double))) == NULL)) {
         if (T != NULL) {
             free(T);
         }
         return 0;
     }
+    lg[0] = 0;
+    for (d = 1; d < nlog; d++)
+        lg[d] = log(d) / log(2);
 
     /* COMPUTE THE EXPECTED:  Formula 16, in Marsaglia's Paper */
     c = 0.7 - 0.8 / (double)L + (4 + 32 / (double)L) * pow(K, -3 / (double)L) / 15;
     sigma = c * sqrt(variance[L] / (double)K);
     sqrt2 = sqrt(2);
     sum = 0.0;
-    for (i = 0; i < p; i++)
-        T[i] = 0;
     for (i = 1; i <= Q; i++) {		/* INITIALIZE TABLE */
-        decRep = 0;
-        for (j = 0; j < L; j++)
-            decRep += epsilon[(i - 1) * L + j] * (long)pow(2, L - 1 - j);
+        decRep = (unsigned int)(window_bits(seq, (i - 1) * L) & low_bits(L));
         T[decRep] = i;
     }
     for (i = Q + 1; i <= Q + K; i++) { 	/* PROCESS BLOCKS */
-        decRep = 0;
-        for (j = 0; j < L; j++)
-            decRep += epsilon[(i - 1) * L + j] * (long)pow(2, L - 1 - j);
-        sum += log(i - T[decRep]) / log(2);
+        decRep = (unsigned int)(window_bits(seq, (i - 1) * L) & low_bits(L));
+        d = i - (int)T[decRep];
+        sum += (d < nlog) ? lg[d] : log(d) / log(2);
         T[decRep] = i;
     }
     phi = (double)(sum / (double)K);
@@ -560,227 +792,272 @@ double test10Universal(int n)
     p_value = erfc(arg);
 
     free(T);
+    free(lg);
     return p_value;
 }
 
-double test11ApproximateEntropy(int n)
+double test10Universal(int n)
+{
+    return sts_test_epsilon(10, n);
+}
+
+/*
+ * Overlapping m-bit pattern counts for the Approximate Entropy (m = 10, 11)
+ * and Serial (m = 14, 15, 16) tests. Only the 16-bit patterns are counted,
+ * from one rolling window; the sequence is circular, so serial_close()
+ * appends its first 15 bits once and then folds each table into the next
+ * shorter one: P[m][x] = P[m+1][2x] + P[m+1][2x+1].
+ */
+#define SERIAL_MIN_M	10
+#define SERIAL_MAX_M	16
+
+typedef struct {
+    int pos;
+    unsigned int window;			/* last bits, most recent in bit 0 */
+    unsigned int head;				/* first SERIAL_MAX_M - 1 bits, first in bit 0 */
+    unsigned int* P[SERIAL_MAX_M + 1];		/* P[m][pattern], first bit most significant */
+} serial_state;
+
+/* all tables in one zeroed block: 2^10 + ... + 2^16 counters */
+#define SERIAL_TABLE_SIZE	(((2u << SERIAL_MAX_M) - (1u << SERIAL_MIN_M)) * sizeof(unsigned int))
+
+static void serial_init(serial_state* st, unsigned int* P)
+{
+    int m;
+
+    memset(st, 0, sizeof(*st));
+    for (m = SERIAL_MIN_M; m <= SERIAL_MAX_M; m++) {
+        st->P[m] = P;
+        P += 1u << m;
+    }
+}
+
+static void serial_update(serial_state* st, const BitWord* seq, int end)
+{
+    int i, len, b;
+    uint64_t x;
+    unsigned int window = st->window, * P = st->P[SERIAL_MAX_M];
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, 0);
+        x = word_bits(seq, i, len);
+        if (i < SERIAL_MAX_M - 1)
+            st->head |= (unsigned int)(x << i) & ((1u << (SERIAL_MAX_M - 1)) - 1);
+        for (b = 0; b < len; b++, x >>= 1) {
+            window = (window << 1) | (unsigned int)(x & 1);
+            if (i + b >= SERIAL_MAX_M - 1)
+                P[window & ((1u << SERIAL_MAX_M) - 1)]++;
+        }
+    }
+    st->window = window;
+    st->pos = end;
+}
+
+static void serial_close(serial_state* st)
+{
+    int t, m;
+    unsigned int x;
+
+    for (t = 0; t < SERIAL_MAX_M - 1; t++) {
+        st->window = (st->window << 1) | ((st->head >> t) & 1);
+        st->P[SERIAL_MAX_M][st->window & ((1u << SERIAL_MAX_M) - 1)]++;
+    }
+    for (m = SERIAL_MAX_M - 1; m >= SERIAL_MIN_M; m--) {
+        for (x = 0; x < (1u << m); x++)
+            st->P[m][x] = st->P[m + 1][2 * x] + st->P[m + 1][2 * x + 1];
+    }
+}
+
+static double apen_p_value(const serial_state* st, int n)
 {
     int m = 10;
-    int				i, j, k, r, blockSize, seqLength, powLen, index;
+    int				i, r, blockSize, seqLength;
     double			sum, numOfBlocks, ApEn[2], apen, chi_squared, p_value;
-    unsigned int* P;
+    const unsigned int* P;
 
     seqLength = n;
+    numOfBlocks = (double)seqLength;
     r = 0;
 
     for (blockSize = m; blockSize <= m + 1; blockSize++) {
-        if (blockSize == 0) {
-            ApEn[0] = 0.00;
-            r++;
-        }
-        else {
-            numOfBlocks = (double)seqLength;
-            powLen = (int)pow(2, blockSize + 1) - 1;
-            if ((P = (unsigned int*)calloc(powLen, sizeof(unsigned int))) == NULL) {
-                return 0;
-            }
-            for (i = 1; i < powLen - 1; i++)
-                P[i] = 0;
-            for (i = 0; i < numOfBlocks; i++) { /* COMPUTE FREQUENCY */
-                k = 1;
-                for (j = 0; j < blockSize; j++) {
-                    k <<= 1;
-                    if ((int)epsilon[(i + j) % seqLength] == 1)
-                        k++;
-                }
-                P[k - 1]++;
-            }
-            /* DISPLAY FREQUENCY */
-            sum = 0.0;
-            index = (int)pow(2, blockSize) - 1;
-            for (i = 0; i < (int)pow(2, blockSize); i++) {
-                if (P[index] > 0)
-                    sum += P[index] * log(P[index] / numOfBlocks);
-                index++;
-            }
-            sum /= numOfBlocks;
-            ApEn[r] = sum;
-            r++;
-            free(P);
+        P = st->P[blockSize];
+        sum = 0.0;
+        for (i = 0; i < (1 << blockSize); i++) {
+            if (P[i] > 0)
+                sum += P[i] * log(P[i] / numOfBlocks);
         }
+        sum /= numOfBlocks;
+        ApEn[r] = sum;
+        r++;
     }
     apen = ApEn[0] - ApEn[1];
 
     chi_squared = 2.0 * seqLength * (log(2) - apen);
     p_value = cephes_igamc(pow(2, m - 1), chi_squared / 2.0);
-	
+
     return p_value;
 }
 
-double test12RandomExcursions(int n)
+double test11ApproximateEntropy(int n)
+{
+    return sts_test_epsilon(11, n);
+}
+
+/*
+ * Random excursion statistics of the walk S = sum(2 * bit - 1), gathered
+ * bit by bit: the cycles between zeros of S, the visits of each cycle to the
+ * states -4..4 (test 12) and the total visits to the states -9..9 (test 13).
+ * excursion_close() ends the last cycle when the walk does not end at 0.
+ */
+#define EXCURSION_STATES	9
+
+typedef struct {
+    int pos;
+    int S;
+    int J;					/* cycles */
+    int maxCycles;			/* test 12 gives up above this many zeros */
+    int counter[8];			/* visits to -4..-1, 1..4 in the current cycle */
+    double nu[6][8];		/* cycles with 0..4, 5+ visits to each state */
+    int visits[2 * EXCURSION_STATES + 1];	/* visits to S - EXCURSION_STATES */
+} excursion_state;
+
+static void excursion_init(excursion_state* st, int n)
 {
-    int		b, i, j, k, J, x;
-    int		cycleStart, cycleStop, * cycle = NULL, * S_k = NULL;
+    memset(st, 0, sizeof(*st));
+    st->maxCycles = MAX(1000, n / 100);
+}
+
+static void excursion_end_cycle(excursion_state* st)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        if ((st->counter[i] >= 0) && (st->counter[i] <= 4))
+            st->nu[st->counter[i]][i]++;
+        else if (st->counter[i] >= 5)
+            st->nu[5][i]++;
+        st->counter[i] = 0;
+    }
+    st->J++;
+}
+
+static void excursion_update(excursion_state* st, const BitWord* seq, int end)
+{
+    int i, len, b, S = st->S;
+    uint64_t x;
+
+    for (i = st->pos; i < end; i += len) {
+        len = chunk_bits(i, end, 0);
+        x = word_bits(seq, i, len);
+        for (b = 0; b < len; b++, x >>= 1) {
+            S += 2 * (int)(x & 1) - 1;
+            if (S == 0) {
+                excursion_end_cycle(st);
+            }
+            else if (S >= -EXCURSION_STATES && S <= EXCURSION_STATES) {
+                st->visits[S + EXCURSION_STATES]++;
+                if (S >= -4 && S <= 4)
+                    st->counter[S + (S < 0 ? 4 : 3)]++;
+            }
+        }
+    }
+    st->S = S;
+    st->pos = end;
+}
+
+static void excursion_close(excursion_state* st)
+{
+    if (st->S != 0)
+        excursion_end_cycle(st);
+}
+
+/*
+ * Both tests only apply with at least `constraint' cycles (NIST SP 800-22
+ * 2.14.7); with fewer they are not applicable and do not fail the sequence.
+ */
+static double random_excursions_p_value(const excursion_state* st, int n)
+{
+    int		i, k, J, x;
     int		stateX[8] = { -4, -3, -2, -1, 1, 2, 3, 4 };
-    int		counter[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-    double	p_value, sum, constraint, nu[6][8];
+    double	p_value, sum, constraint;
     double	pi[5][6] = { {0.0000000000, 0.00000000000, 0.00000000000, 0.00000000000, 0.00000000000, 0.0000000000},
                          {0.5000000000, 0.25000000000, 0.12500000000, 0.06250000000, 0.03125000000, 0.0312500000},
                          {0.7500000000, 0.06250000000, 0.04687500000, 0.03515625000, 0.02636718750, 0.0791015625},
                          {0.8333333333, 0.02777777778, 0.02314814815, 0.01929012346, 0.01607510288, 0.0803755143},
                          {0.8750000000, 0.01562500000, 0.01367187500, 0.01196289063, 0.01046752930, 0.0732727051} };
 
-    if (((S_k = (int*)calloc(n, sizeof(int))) == NULL) ||
-        ((cycle = (int*)calloc(MAX(1000, n / 100), sizeof(int))) == NULL)) {
-        if (S_k != NULL)
-            free(S_k);
-        if (cycle != NULL)
-            free(cycle);
+    J = st->J;
+    /* the cycle ended by the last bit is not counted against the limit */
+    if (J - (st->S != 0) > st->maxCycles)
         return 0;
-    }
-
-    J = 0; 					/* DETERMINE CYCLES */
-    S_k[0] = 2 * (int)epsilon[0] - 1;
-    for (i = 1; i < n; i++) {
-        S_k[i] = S_k[i - 1] + 2 * epsilon[i] - 1;
-        if (S_k[i] == 0) {
-            J++;
-            if (J > MAX(1000, n / 100)) {
-                free(S_k);
-                free(cycle);
-                return 0;
-            }
-            cycle[J] = i;
-        }
-    }
-    if (S_k[n - 1] != 0)
-        J++;
-    cycle[J] = n;
 
+    p_value = 1;
     constraint = MAX(0.005 * pow(n, 0.5), 500);
     if (J >= constraint) {
-        cycleStart = 0;
-        cycleStop = cycle[1];
-        for (k = 0; k < 6; k++)
-            for (i = 0; i < 8; i++)
-                nu[k][i] = 0.;
-        for (j = 1; j <= J; j++) {                           /* FOR EACH CYCLE */
-            for (i = 0; i < 8; i++)
-                counter[i] = 0;
-            for (i = cycleStart; i < cycleStop; i++) {
-                if ((S_k[i] >= 1 && S_k[i] <= 4) || (S_k[i] >= -4 && S_k[i] <= -1)) {
-                    if (S_k[i] < 0)
-                        b = 4;
-                    else
-                        b = 3;
-                    counter[S_k[i] + b]++;
-                }
-            }
-            cycleStart = cycle[j] + 1;
-            if (j < J)
-                cycleStop = cycle[j + 1];
-
-            for (i = 0; i < 8; i++) {
-                if ((counter[i] >= 0) && (counter[i] <= 4))
-                    nu[counter[i]][i]++;
-                else if (counter[i] >= 5)
-                    nu[5][i]++;
-            }
-        }
-
-        p_value = 1;
         for (i = 0; i < 8; i++) {
             x = stateX[i];
             sum = 0.;
             for (k = 0; k < 6; k++)
-                sum += pow(nu[k][i] - J * pi[(int)fabs(x)][k], 2) / (J * pi[(int)fabs(x)][k]);
+                sum += pow(st->nu[k][i] - J * pi[(int)fabs(x)][k], 2) / (J * pi[(int)fabs(x)][k]);
             p_value = MIN(p_value, cephes_igamc(2.5, sum / 2.0));
         }
     }
-    free(S_k);
-    free(cycle);
     return p_value;
 }
 
-double test13RandomExcursionsVariant(int n)
+static double random_excursions_variant_p_value(const excursion_state* st, int n)
 {
-    int		i, p, J, x, constraint, count, * S_k;
+    int		p, J, x, constraint, count;
     int		stateX[18] = { -9, -8, -7, -6, -5, -4, -3, -2, -1, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
     double	p_value;
 
-    if ((S_k = (int*)calloc(n, sizeof(int))) == NULL) {
-        return 0;
-    }
-    J = 0;
-    S_k[0] = 2 * (int)epsilon[0] - 1;
-    for (i = 1; i < n; i++) {
-        S_k[i] = S_k[i - 1] + 2 * epsilon[i] - 1;
-        if (S_k[i] == 0)
-            J++;
-    }
-    if (S_k[n - 1] != 0)
-        J++;
-
+    J = st->J;
+    p_value = 1;
     constraint = (int)MAX(0.005 * pow(n, 0.5), 500);
     if (J >= constraint) {
-        p_value = 1;
         for (p = 0; p <= 17; p++) {
             x = stateX[p];
-            count = 0;
-            for (i = 0; i < n; i++)
-                if (S_k[i] == x)
-                    count++;
+            count = st->visits[x + EXCURSION_STATES];
             p_value = MIN(p_value, erfc(fabs(count - J) / (sqrt(2.0 * J * (4.0 * fabs(x) - 2)))));
         }
     }
-    free(S_k);
     return p_value;
 }
 
-double
-psi2(int m, int n)
+double test12RandomExcursions(int n)
 {
-    int				i, j, k, powLen;
-    double			sum, numOfBlocks;
-    unsigned int* P;
+    return sts_test_epsilon(12, n);
+}
+
+double test13RandomExcursionsVariant(int n)
+{
+    return sts_test_epsilon(13, n);
+}
+
+static double
+psi2(const serial_state* st, int m, int n)
+{
+    int				i;
+    double			sum;
+    const unsigned int* P = st->P[m];
 
-    if ((m == 0) || (m == -1))
-        return 0.0;
-    numOfBlocks = n;
-    powLen = (int)pow(2, m + 1) - 1;
-    if ((P = (unsigned int*)calloc(powLen, sizeof(unsigned int))) == NULL) {
-        return 0.0;
-    }
-    for (i = 1; i < powLen - 1; i++)
-        P[i] = 0;	  /* INITIALIZE NODES */
-    for (i = 0; i < numOfBlocks; i++) {		 /* COMPUTE FREQUENCY */
-        k = 1;
-        for (j = 0; j < m; j++) {
-            if (epsilon[(i + j) % n] == 0)
-                k *= 2;
-            else if (epsilon[(i + j) % n] == 1)
-                k = 2 * k + 1;
-        }
-        P[k - 1]++;
-    }
     sum = 0.0;
-    for (i = (int)pow(2, m) - 1; i < (int)pow(2, m + 1) - 1; i++)
-        sum += pow(P[i], 2);
+    for (i = 0; i < (1 << m); i++)
+        sum += (double)P[i] * P[i];
     sum = (sum * pow(2, m) / (double)n) - (double)n;
-    free(P);
 
     return sum;
 }
 
-double test14Serial(int n)
+static double serial_p_value(const serial_state* st, int n)
 {
     int m = 16;
 
     double	p_value1, p_value2, psim0, psim1, psim2, del1, del2;
 
-    psim0 = psi2(m, n);
-    psim1 = psi2(m - 1, n);
-    psim2 = psi2(m - 2, n);
+    psim0 = psi2(st, m, n);
+    psim1 = psi2(st, m - 1, n);
+    psim2 = psi2(st, m - 2, n);
     del1 = psim0 - psim1;
     del2 = psim0 - 2.0 * psim1 + psim2;
     p_value1 = cephes_igamc(pow(2, m - 1) / 2, del1 / 2.0);
@@ -788,81 +1065,85 @@ double test14Serial(int n)
     return MIN(p_value1, p_value2);
 }
 
-double test15LinearComplexity(int n)
+double test14Serial(int n)
+{
+    return sts_test_epsilon(14, n);
+}
+
+/*
+ * Berlekamp-Massey over GF(2) with the polynomials packed in words: bit i of
+ * C, B and T is the coefficient of x^i, and bit i of R is the sequence bit
+ * i places before the current one, so the discrepancy is the parity of C & R.
+ */
+#define LINEAR_COMPLEXITY_M	500
+#define LC_WORDS			(LINEAR_COMPLEXITY_M / WORD_BITS + 1)
+
+/* C ^= B * x^s */
+static void lc_add_shifted(uint64_t* C, const uint64_t* B, int s)
+{
+    int w, q = s / WORD_BITS, r = s % WORD_BITS;
+
+    for (w = LC_WORDS - 1; w >= q; w--) {
+        C[w] ^= B[w - q] << r;
+        if (r && w - q > 0)
+            C[w] ^= B[w - q - 1] >> (WORD_BITS - r);
+    }
+}
+
+static double linear_complexity_p_value(const BitWord* seq, int n)
 {
-    int M = 500;
-    int       i, ii, j, d, N, L, m, N_, parity, sign, K = 6;
+    int M = LINEAR_COMPLEXITY_M;
+    int       i, ii, w, d, N, L, m, N_, parity, sign, K = 6, pos;
     double    p_value, T_, mean, nu[7], chi2;
     double    pi[7] = { 0.01047, 0.03125, 0.12500, 0.50000, 0.25000, 0.06250, 0.020833 };
-    BitSequence* T = NULL, * P = NULL, * B_ = NULL, * C = NULL;
+    uint64_t  T[LC_WORDS], B_[LC_WORDS], C[LC_WORDS], R[LC_WORDS], acc;
 
     N = (int)floor(n / M);
-    if (((B_ = (BitSequence*)calloc(M, sizeof(BitSequence))) == NULL) ||
-        ((C = (BitSequence*)calloc(M, sizeof(BitSequence))) == NULL) ||
-        ((P = (BitSequence*)calloc(M, sizeof(BitSequence))) == NULL) ||
-        ((T = (BitSequence*)calloc(M, sizeof(BitSequence))) == NULL)) {
-        printf("Insufficient Memory for Work Space:: Linear Complexity Test\n");
-        if (B_ != NULL)
-            free(B_);
-        if (C != NULL)
-            free(C);
-        if (P != NULL)
-            free(P);
-        if (T != NULL)
-            free(T);
-        return 0;
-    }
+
+    if ((parity = (M + 1) % 2) == 0)
+        sign = -1;
+    else
+        sign = 1;
+    mean = M / 2.0 + (9.0 + sign) / 36.0 - 1.0 / pow(2, M) * (M / 3.0 + 2.0 / 9.0);
+    if ((parity = M % 2) == 0)
+        sign = 1;
+    else
+        sign = -1;
 
     for (i = 0; i < K + 1; i++)
         nu[i] = 0.00;
     for (ii = 0; ii < N; ii++) {
-        for (i = 0; i < M; i++) {
-            B_[i] = 0;
-            C[i] = 0;
-            T[i] = 0;
-            P[i] = 0;
+        for (w = 0; w < LC_WORDS; w++) {
+            B_[w] = 0;
+            C[w] = 0;
+            R[w] = 0;
         }
         L = 0;
         m = -1;
-        d = 0;
         C[0] = 1;
         B_[0] = 1;
 
         /* DETERMINE LINEAR COMPLEXITY */
-        N_ = 0;
-        while (N_ < M) {
-            d = (int)epsilon[ii * M + N_];
-            for (i = 1; i <= L; i++)
-                d += C[i] * epsilon[ii * M + N_ - i];
-            d = d % 2;
+        for (N_ = 0; N_ < M; N_++) {
+            for (w = LC_WORDS - 1; w > 0; w--)
+                R[w] = (R[w] << 1) | (R[w - 1] >> (WORD_BITS - 1));
+            pos = ii * M + N_;
+            R[0] = (R[0] << 1) | ((seq[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1);
+
+            acc = 0;
+            for (w = 0; w <= L / WORD_BITS; w++)
+                acc ^= C[w] & R[w];
+            d = popcount64(acc) & 1;
             if (d == 1) {
-                for (i = 0; i < M; i++) {
-                    T[i] = C[i];
-                    P[i] = 0;
-                }
-                for (j = 0; j < M; j++)
-                    if (B_[j] == 1)
-                        P[j + N_ - m] = 1;
-                for (i = 0; i < M; i++)
-                    C[i] = (C[i] + P[i]) % 2;
+                memcpy(T, C, sizeof(T));
+                lc_add_shifted(C, B_, N_ - m);
                 if (L <= N_ / 2) {
                     L = N_ + 1 - L;
                     m = N_;
-                    for (i = 0; i < M; i++)
-                        B_[i] = T[i];
+                    memcpy(B_, T, sizeof(B_));
                 }
             }
-            N_++;
         }
-        if ((parity = (M + 1) % 2) == 0)
-            sign = -1;
-        else
-            sign = 1;
-        mean = M / 2.0 + (9.0 + sign) / 36.0 - 1.0 / pow(2, M) * (M / 3.0 + 2.0 / 9.0);
-        if ((parity = M % 2) == 0)
-            sign = 1;
-        else
-            sign = -1;
         T_ = sign * (L - mean) + 2.0 / 9.0;
 
         if (T_ <= -2.5)
@@ -885,90 +1166,532 @@ double test15LinearComplexity(int n)
         chi2 += pow(nu[i] - N * pi[i], 2) / (N * pi[i]);
     p_value = cephes_igamc(K / 2.0, chi2 / 2.0);
 
-    free(B_);
-    free(P);
-    free(C);
-    free(T);
     return p_value;
 }
 
-int nist_randomness_evaluate(unsigned char *rnd)
-{
-	int n;
-	int i,j,k;
-	unsigned char rnd_byte;
-
-	double p_value;
-	double (*pf[15])(int) = {
-        test01Frequency,
-        test02BlockFrequency,
-        test03CumulativeSums,
-        test04Runs,
-        test05LongestRunOfOnes,
-        test06Rank,
-        test07DiscreteFourierTransform,
-        test08NonOverlappingTemplateMatchings,
-        test09OverlappingTemplateMatchings,
-        test10Universal,
-        test11ApproximateEntropy,
-        test12RandomExcursions,
-        test13RandomExcursionsVariant,
-        test14Serial,
-        test15LinearComplexity
-    };
-	char* msg[] = {
-        "The Frequency (Monobit) Test Passed.\n",
-        "Frequency Test within a Block Passed.\n",
-        "The Cumulative Sums (Cusums) Test Passed.\n",
-        "The Runs Test Passed.\n",
-        "Tests for the Longest-Run-of-Ones in a Block Passed.\n",
-        "The Binary Matrix Rank Test Passed.\n",
-        "The Discrete Fourier Transform (Spectral) Test Passed.\n",
-        "The Non-overlapping Template Matching Test Passed.\n",
-        "The Overlapping Template Matching Test Passed.\n",
-        "Maurer's \"Universal Statistical\" Test Passed.\n",
-        "The Approximate Entropy Test Passed.\n",
-        "The Random Excursions Test Passed.\n",
-        "The Random Excursions Variant Test Passed.\n",
-        "The Serial Test Passed.\n",
-		"The Linear Complexity Test Passed.\n"
-	};
-
-	n = 1024*1024*8;
-	epsilon = (BitSequence*)calloc(n, sizeof(BitSequence));
-
-	if (!epsilon) {
-		printf("Failed to allocate memory.\n");
-		return 20;
-	}
-	k = 0;
-    for (i = 1; i < n / 8; i++) {
-		rnd_byte = rnd[i];
-//printf("rnd_byte = %d\n", rnd_byte);
-//printf("i = %d\n", i);
-		for (j = 0; j < 8; j++) {
-			epsilon[k] = (rnd_byte & 0x01);
-			rnd_byte >>= 1;
-            k++;
+double test15LinearComplexity(int n)
+{
+    return sts_test_epsilon(15, n);
+}
 
-        }
-	}
+/* test i on its own over n packed bits, without the streaming context */
+double sts_test(int i, const BitWord* seq, int n)
+{
+    frequency_state frequency = { 0, 0 };
+    block_frequency_state block_frequency = { 0, 0, 0.0 };
+    cusum_state cusum;
+    runs_state runs = { 0, 0, 1, 0 };
+    longest_run_state longest_run;
+    rank_state rank = { 0, 0, 0 };
+    serial_state serial;
+    excursion_state excursion;
+    unsigned int* P;
+    double p_value;
+
+    switch (i) {
+    case 1:
+        frequency_update(&frequency, seq, n);
+        return frequency_p_value(&frequency, n);
+    case 2:
+        block_frequency_update(&block_frequency, seq, n);
+        return block_frequency_p_value(&block_frequency, n);
+    case 3:
+        cusum_init(&cusum);
+        cusum_update(&cusum, seq, n);
+        return cusum_p_value(&cusum, n);
+    case 4:
+        runs_update(&runs, seq, n);
+        return runs_p_value(&runs, n);
+    case 5:
+        longest_run_init(&longest_run, n);
+        longest_run_update(&longest_run, seq, n);
+        return longest_run_p_value(&longest_run, n);
+    case 6:
+        rank_update(&rank, seq, n);
+        return rank_p_value(&rank, n);
+    case 7:
+        return dft_p_value(seq, n, DFT_SINGLE, NULL);
+    case 8:
+        return non_overlapping_template_p_value(seq, n);
+    case 9:
+        return overlapping_template_p_value(seq, n);
+    case 10:
+        return universal_p_value(seq, n);
+    case 11:
+    case 14:
+        if ((P = (unsigned int*)calloc(1, SERIAL_TABLE_SIZE)) == NULL)
+            return 0.0;
+        serial_init(&serial, P);
+        serial_update(&serial, seq, n);
+        serial_close(&serial);
+        p_value = (i == 11) ? apen_p_value(&serial, n) : serial_p_value(&serial, n);
+        free(P);
+        return p_value;
+    case 12:
+    case 13:
+        excursion_init(&excursion, n);
+        excursion_update(&excursion, seq, n);
+        excursion_close(&excursion);
+        return (i == 12) ? random_excursions_p_value(&excursion, n) : random_excursions_variant_p_value(&excursion, n);
+    case 15:
+        return linear_complexity_p_value(seq, n);
+    default:
+        return 0.0;
+    }
+}
+
+static const char* const sts_messages[STS_NUM_TESTS] = {
+    "The Frequency (Monobit) Test Passed.\n",
+    "Frequency Test within a Block Passed.\n",
+    "The Cumulative Sums (Cusums) Test Passed.\n",
+    "The Runs Test Passed.\n",
+    "Tests for the Longest-Run-of-Ones in a Block Passed.\n",
+    "The Binary Matrix Rank Test Passed.\n",
+    "The Discrete Fourier Transform (Spectral) Test Passed.\n",
+    "The Non-overlapping Template Matching Test Passed.\n",
+    "The Overlapping Template Matching Test Passed.\n",
+    "Maurer's \"Universal Statistical\" Test Passed.\n",
+    "The Approximate Entropy Test Passed.\n",
+    "The Random Excursions Test Passed.\n",
+    "The Random Excursions Variant Test Passed.\n",
+    "The Serial Test Passed.\n",
+    "The Linear Complexity Test Passed.\n"
+};
+
+/*
+ * Streaming evaluation: the statistics of tests 1-6 and 11-14 are
+ * accumulated while the data is fed, the remaining tests run on the stored
+ * packed sequence in sts_finish().
+ *
+ * Bit layout, as nist_randomness_evaluate has always used it: the first
+ * STS_SKIP_BYTES input bytes are not tested, each byte is unpacked least
+ * significant bit first, and a sequence short by at most STS_PAD_BITS bits
+ * is completed with zeros.
+ */
+#define STS_SKIP_BYTES	1
+#define STS_PAD_BITS	8
+
+/*
+ * The large buffers of a context (packed sequence, serial tables and the DFT
+ * work area) are carved from the block of a workspace, which is allocated
+ * once and kept for the next contexts. sts_begin() runs the DFT in double
+ * precision if that fits the workspace budget, in single precision
+ * otherwise. The context itself and the per-test tables of a few KB are not
+ * counted.
+ */
+#define STS_ALIGN(x)	(((x) + 63) & ~(size_t)63)
+
+struct sts_workspace {
+    size_t budget;			/* 0: no limit */
+    size_t size;			/* bytes in base */
+    unsigned char* base;
+    int busy;				/* a context is using it */
+};
+
+typedef struct {
+    size_t words, serial, dft;		/* offsets in the workspace */
+    size_t size;
+    int single;				/* DFT in single precision */
+} sts_layout;
+
+static void sts_layout_make(sts_layout* lay, int n, int single)
+{
+    lay->single = single;
+    lay->words = 0;
+    lay->serial = STS_ALIGN((n / WORD_BITS + 2) * sizeof(BitWord));
+    lay->dft = lay->serial + STS_ALIGN(SERIAL_TABLE_SIZE);
+    lay->size = lay->dft + STS_ALIGN(dft_work_size(n, single));
+}
 
-    for (i = 1; i < 16; i++) {
-        //bypass test08.
-        if (i == 8) {
+/* the fastest layout for n bits within budget, -1 if none fits */
+static int sts_layout_choose(sts_layout* lay, int n, size_t budget)
+{
+    int single;
+
+    for (single = DFT_SINGLE; single <= 1; single++) {
+        sts_layout_make(lay, n, single);
+        if (budget == 0 || lay->size <= budget)
+            return 0;
+    }
+    return -1;
+}
+
+sts_workspace* sts_workspace_create(size_t budget)
+{
+    sts_workspace* ws;
+
+    if ((ws = (sts_workspace*)calloc(1, sizeof(sts_workspace))) == NULL)
+        return NULL;
+    ws->budget = budget;
+    return ws;
+}
+
+size_t sts_workspace_min_budget(int n)
+{
+    sts_layout lay;
+
+    sts_layout_make(&lay, n, 1);
+    return lay.size;
+}
+
+size_t sts_workspace_size(const sts_workspace* ws)
+{
+    return ws->size;
+}
+
+void sts_workspace_free(sts_workspace* ws)
+{
+    if (ws == NULL)
+        return;
+    free(ws->base);
+    free(ws);
+}
+
+/* at least size bytes in ws, keeping the block when it is large enough */
+static int sts_workspace_reserve(sts_workspace* ws, size_t size)
+{
+    void* base;
+
+    if (ws->size >= size)
+        return 0;
+    free(ws->base);
+    ws->base = NULL;
+    ws->size = 0;
+    if (posix_memalign(&base, 64, size))
+        return -1;
+    ws->base = (unsigned char*)base;
+    ws->size = size;
+    return 0;
+}
+
+struct sts_ctx {
+    int n;
+    int pos;			/* bits stored so far */
+    int skip;			/* input bytes still to drop */
+    sts_workspace* ws;
+    int own_ws;			/* ws was created for this context */
+    sts_layout layout;
+    BitWord* words;		/* packed sequence */
+    void* dft_work;		/* work area of test 07 */
+    frequency_state frequency;
+    block_frequency_state block_frequency;
+    cusum_state cusum;
+    runs_state runs;
+    longest_run_state longest_run;
+    rank_state rank;
+    serial_state serial;
+    excursion_state excursion;
+};
+
+static void sts_update(sts_ctx* ctx)
+{
+    frequency_update(&ctx->frequency, ctx->words, ctx->pos);
+    block_frequency_update(&ctx->block_frequency, ctx->words, ctx->pos);
+    cusum_update(&ctx->cusum, ctx->words, ctx->pos);
+    runs_update(&ctx->runs, ctx->words, ctx->pos);
+    longest_run_update(&ctx->longest_run, ctx->words, ctx->pos);
+    rank_update(&ctx->rank, ctx->words, ctx->pos);
+    serial_update(&ctx->serial, ctx->words, ctx->pos);
+    excursion_update(&ctx->excursion, ctx->words, ctx->pos);
+}
+
+sts_ctx* sts_begin(int n, sts_workspace* ws)
+{
+    sts_ctx* ctx;
+    sts_workspace* own = NULL;
+
+    if (n <= 0)
+        return NULL;
+    if ((ctx = (sts_ctx*)calloc(1, sizeof(sts_ctx))) == NULL)
+        return NULL;
+    if (ws == NULL && (ws = own = sts_workspace_create(0)) == NULL) {
+        free(ctx);
+        return NULL;
+    }
+    if (ws->busy || sts_layout_choose(&ctx->layout, n, ws->budget) ||
+        sts_workspace_reserve(ws, ctx->layout.size)) {
+        sts_workspace_free(own);
+        free(ctx);
+        return NULL;
+    }
+    ws->busy = 1;
+    ctx->ws = ws;
+    ctx->own_ws = (own != NULL);
+
+    ctx->n = n;
+    ctx->skip = STS_SKIP_BYTES;
+    ctx->words = (BitWord*)(ws->base + ctx->layout.words);
+    ctx->dft_work = ws->base + ctx->layout.dft;
+    memset(ws->base, 0, ctx->layout.dft);		/* packed words and serial tables */
+    cusum_init(&ctx->cusum);
+    ctx->runs.V = 1;
+    longest_run_init(&ctx->longest_run, n);
+    excursion_init(&ctx->excursion, n);
+    serial_init(&ctx->serial, (unsigned int*)(ws->base + ctx->layout.serial));
+    return ctx;
+}
+
+void sts_feed(sts_ctx* ctx, const unsigned char* data, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (ctx->skip > 0) {
+            ctx->skip--;
             continue;
         }
-        p_value = pf[i - 1](n);
-//        printf("p_value = %.10f\n", p_value);//输出保留小数点后10位
-        if (p_value < ALPHA) {
-            free(epsilon);
+        if (ctx->n - ctx->pos < 8)
+            break;		/* surplus data is not tested */
+        ctx->words[ctx->pos / WORD_BITS] |= (BitWord)data[i] << (ctx->pos % WORD_BITS);
+        ctx->pos += 8;
+    }
+    sts_update(ctx);
+}
+
+/* the p-value of test i, from the state or from the packed sequence */
+static double sts_p_value(const sts_ctx* ctx, int i)
+{
+    switch (i) {
+    case 1:
+        return frequency_p_value(&ctx->frequency, ctx->n);
+    case 2:
+        return block_frequency_p_value(&ctx->block_frequency, ctx->n);
+    case 3:
+        return cusum_p_value(&ctx->cusum, ctx->n);
+    case 4:
+        return runs_p_value(&ctx->runs, ctx->n);
+    case 5:
+        return longest_run_p_value(&ctx->longest_run, ctx->n);
+    case 6:
+        return rank_p_value(&ctx->rank, ctx->n);
+    case 7:
+        return dft_p_value(ctx->words, ctx->n, ctx->layout.single, ctx->dft_work);
+    case 8:
+        return non_overlapping_template_p_value(ctx->words, ctx->n);
+    case 9:
+        return overlapping_template_p_value(ctx->words, ctx->n);
+    case 10:
+        return universal_p_value(ctx->words, ctx->n);
+    case 15:
+        return linear_complexity_p_value(ctx->words, ctx->n);
+    case 11:
+        return apen_p_value(&ctx->serial, ctx->n);
+    case 12:
+        return random_excursions_p_value(&ctx->excursion, ctx->n);
+    case 13:
+        return random_excursions_variant_p_value(&ctx->excursion, ctx->n);
+    case 14:
+        return serial_p_value(&ctx->serial, ctx->n);
+    default:
+        return 0.0;
+    }
+}
+
+/*
+ * The tests run in tiers of increasing cost at finish time (measured with
+ * stsbench at 8M bits): tier 0 only turns the streamed statistics into
+ * p-values, tier 1 takes milliseconds, tier 2 (spectral and linear
+ * complexity) a few hundred milliseconds. A tier starts only when every test
+ * before it passed; a started tier always runs to the end, so the report
+ * does not depend on the number of threads. Tiers 1 and 2 are shared out to
+ * one thread pool for the whole process, so that several contexts finishing
+ * at once do not each start ncpu threads; each test only reads the finished
+ * context.
+ */
+static const struct {
+    int test;
+    int tier;
+} sts_schedule[STS_NUM_TESTS] = {
+    { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 }, { 11, 0 }, { 12, 0 }, { 13, 0 }, { 14, 0 },
+    { 9, 1 }, { 10, 1 }, { 8, 1 },
+    { 7, 2 }, { 15, 2 }
+};
+
+/*
+ * The level each reported p-value is compared with. Test 08 reports the
+ * smallest of MAXNUMOFTEMPLATES per-template p-values: each template is a
+ * test of its own at level 1 - (1 - ALPHA)^(1/148) (Sidak), so that a random
+ * sequence still fails test 08 with probability ALPHA, like any other test.
+ */
+static double sts_alpha(int i)
+{
+    if (i == 8)
+        return -expm1(log1p(-ALPHA) / MAXNUMOFTEMPLATES);
+    return ALPHA;
+}
+
+typedef struct sts_run {
+    const sts_ctx* ctx;
+    int next;				/* next schedule entry to start */
+    int end;				/* end of the tier */
+    int running;			/* tests started and not finished yet */
+    struct sts_run* queued;		/* next run waiting for the pool */
+    double p_value[STS_NUM_TESTS + 1];
+} sts_run;
+
+/*
+ * ncpu - 1 threads, started on first use and kept for the life of the process;
+ * the thread calling sts_finish() works on its own tier as well. Everything
+ * below is protected by the pool lock.
+ */
+static struct {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t work;		/* a run was queued */
+    pthread_cond_t done;		/* a test finished */
+    sts_run* runs;			/* runs with tests left to start, oldest first */
+    int nthreads;
+} sts_pool = { PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0 };
+
+/* start the next test of run, called and returning with the pool lock held */
+static void sts_run_next(sts_run* run)
+{
+    sts_run** q;
+    double p_value;
+    int i;
+
+    i = sts_schedule[run->next++].test;
+    if (run->next >= run->end) {
+        for (q = &sts_pool.runs; *q != NULL; q = &(*q)->queued) {
+            if (*q == run) {
+                *q = run->queued;
+                break;
+            }
+        }
+    }
+    run->running++;
+    pthread_mutex_unlock(&sts_pool.lock);
+
+    p_value = sts_p_value(run->ctx, i);
+
+    pthread_mutex_lock(&sts_pool.lock);
+    run->p_value[i] = p_value;
+    if (--run->running == 0 && run->next >= run->end)
+        pthread_cond_broadcast(&sts_pool.done);
+}
+
+static void* sts_pool_thread(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&sts_pool.lock);
+    for (;;) {
+        while (sts_pool.runs == NULL)
+            pthread_cond_wait(&sts_pool.work, &sts_pool.lock);
+        sts_run_next(sts_pool.runs);
+    }
+    return NULL;
+}
+
+static void sts_pool_start(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i, ncpu;
+
+    ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (pthread_attr_init(&attr))
+        return;
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (i = 0; i < ncpu - 1; i++) {
+        if (pthread_create(&thread, &attr, sts_pool_thread, NULL))
+            break;
+    }
+    pthread_attr_destroy(&attr);
+    pthread_mutex_lock(&sts_pool.lock);
+    sts_pool.nthreads = i;
+    pthread_mutex_unlock(&sts_pool.lock);
+}
+
+/* the schedule entries [first, end), on the calling thread and the pool */
+static void sts_run_tier(sts_run* run, int first, int end)
+{
+    if (sts_schedule[first].tier != 0)
+        pthread_once(&sts_pool.once, sts_pool_start);
+
+    pthread_mutex_lock(&sts_pool.lock);
+    run->next = first;
+    run->end = end;
+    if (sts_schedule[first].tier != 0 && sts_pool.nthreads > 0 && end - first > 1) {
+        sts_run** q;
+
+        for (q = &sts_pool.runs; *q != NULL; q = &(*q)->queued)
+            ;
+        run->queued = NULL;
+        *q = run;
+        pthread_cond_broadcast(&sts_pool.work);
+    }
+    while (run->next < run->end)
+        sts_run_next(run);
+    while (run->running)
+        pthread_cond_wait(&sts_pool.done, &sts_pool.lock);
+    pthread_mutex_unlock(&sts_pool.lock);
+}
 
-            return i;
+int sts_finish(sts_ctx* ctx, sts_report* report)
+{
+    int i, k, first, end;
+    sts_report local;
+    sts_run run;
+
+    if (report == NULL)
+        report = &local;
+    memset(report, 0, sizeof(*report));
+    if (ctx->n - ctx->pos > STS_PAD_BITS) {
+        printf("Not enough data for the randomness tests.\n");
+        sts_free(ctx);
+        report->failed = STS_ERROR;
+        return STS_ERROR;
+    }
+    /* the tail is already zero (calloc) */
+    ctx->pos = ctx->n;
+    sts_update(ctx);
+    serial_close(&ctx->serial);
+    excursion_close(&ctx->excursion);
+
+    memset(&run, 0, sizeof(run));
+    run.ctx = ctx;
+
+    for (first = 0; first < STS_NUM_TESTS && report->failed == 0; first = end) {
+        for (end = first; end < STS_NUM_TESTS && sts_schedule[end].tier == sts_schedule[first].tier; end++)
+            ;
+        sts_run_tier(&run, first, end);
+        for (k = first; k < end; k++) {
+            i = sts_schedule[k].test;
+            report->run[i] = 1;
+            report->p_value[i] = run.p_value[i];
+            if (run.p_value[i] < sts_alpha(i) && (report->failed == 0 || i < report->failed))
+                report->failed = i;
         }
-        printf("%s", msg[i - 1]);
     }
-	free(epsilon);
-	return 0;
+
+    for (i = 1; i <= STS_NUM_TESTS; i++) {
+//        printf("p_value = %.10f\n", report->p_value[i]);//输出保留小数点后10位
+        if (report->run[i] && report->p_value[i] >= sts_alpha(i))
+            printf("%s", sts_messages[i - 1]);
+    }
+
+    sts_free(ctx);
+    return report->failed;
+}
+
+void sts_free(sts_ctx* ctx)
+{
+    if (ctx == NULL)
+        return;
+    ctx->ws->busy = 0;
+    if (ctx->own_ws)
+        sts_workspace_free(ctx->ws);
+    free(ctx);
 }
 
+int nist_randomness_evaluate(const unsigned char* rnd)
+{
+    sts_ctx* ctx;
+
+    if ((ctx = sts_begin(STS_SEQUENCE_BITS, NULL)) == NULL) {
+        printf("Failed to allocate memory.\n");
+        return STS_ERROR;
+    }
+    sts_feed(ctx, rnd, STS_SEQUENCE_BITS / 8);
+    return sts_finish(ctx, NULL);
+}
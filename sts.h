@@ -5,7 +5,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define MAX(x,y)             ((x) <  (y)  ? (y)  : (x))
 #define MIN(x,y)             ((x) >  (y)  ? (y)  : (x))
@@ -18,9 +22,14 @@
 
 #define ALPHA							0.01	/* SIGNIFICANCE LEVEL */
 #define MAXNUMOFTEMPLATES				148		/* APERIODIC TEMPLATES: 148=>temp_length=9 */
+#define STS_SEQUENCE_BITS				(1024*1024*8)	/* BITS TESTED PER RANDOM FILE */
+#define STS_NUM_TESTS					15
+#define STS_ERROR						20		/* RESULT WHEN THE TESTS COULD NOT RUN */
+/* #define STS_DFT_SINGLE */					/* SPECTRAL TEST IN SINGLE PRECISION */
 
 typedef unsigned char	BitSequence;
-extern BitSequence* epsilon;
+typedef uint64_t		BitWord;		/* 64 PACKED BITS, FIRST BIT IN BIT 0 */
+extern __thread BitSequence* epsilon;
 
 double cephes_igamc(double a, double x);
 double cephes_igam(double a, double x);
@@ -32,6 +41,7 @@ double cephes_erfc(double x);
 double cephes_normal(double x);
 
 int				computeRank(int M, int Q, BitSequence** matrix);
+int				computeRank32(uint32_t* rows);
 void			perform_elementary_row_operations(int flag, int i, int M, int Q, BitSequence** A);
 int				find_unit_element_and_swap(int flag, int i, int M, int Q, BitSequence** A);
 int				swap_rows(int i, int index, int Q, BitSequence** A);
@@ -41,6 +51,42 @@ void			display_matrix(int M, int Q, BitSequence** m);
 void			def_matrix(int M, int Q, BitSequence** m, int k);
 void			delete_matrix(int M, BitSequence** matrix);
 
-int nist_randomness_evaluate(unsigned char* rnd);
+/* Real FFT of n = 2 * 4^k bits: count of |X[k]| < bound for k < n/2, -1 for other n */
+size_t			rfft_work_size(int n, int single);	/* 0 for other n */
+int				rfft_count_below(int n, const BitWord* seq, double bound, void* work);
+int				rfft_count_below_f(int n, const BitWord* seq, double bound, void* work);
+
+int nist_randomness_evaluate(const unsigned char* rnd);
+double			sts_test(int i, const BitWord* seq, int n);		/* test i (1 to STS_NUM_TESTS) alone on n packed bits */
+
+/* Incremental evaluation: feed the data as it is produced, then finish */
+typedef struct sts_ctx sts_ctx;
+
+/* Memory of the contexts, allocated once and reused; budget in bytes, 0 for no limit */
+typedef struct sts_workspace sts_workspace;
+
+sts_workspace*	sts_workspace_create(size_t budget);
+size_t			sts_workspace_min_budget(int n);		/* smallest budget sts_begin() accepts for n bits */
+size_t			sts_workspace_size(const sts_workspace* ws);
+void			sts_workspace_free(sts_workspace* ws);
+
+/*
+ * Result of sts_finish(): the tests run cheapest first, in tiers, and stop
+ * after the first tier with a failure; tests that did not run have run[i] 0.
+ */
+typedef struct {
+    int failed;							/* lowest failing test, 0 if all passed, STS_ERROR */
+    int run[STS_NUM_TESTS + 1];			/* test i (1 to STS_NUM_TESTS) ran */
+    double p_value[STS_NUM_TESTS + 1];
+} sts_report;
+
+sts_ctx*		sts_begin(int n, sts_workspace* ws);	/* one context at a time per ws, NULL for private memory */
+void			sts_feed(sts_ctx* ctx, const unsigned char* data, int len);
+int				sts_finish(sts_ctx* ctx, sts_report* report);	/* returns report->failed; report may be NULL */
+void			sts_free(sts_ctx* ctx);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
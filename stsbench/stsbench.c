@@ -0,0 +1,348 @@
+/*
+ * Standalone benchmark of the NIST tests in sts.c.
+ *
+ * Every test runs alone (sts_test) on each 1 MiB input, fixed-seed or read
+ * from recorded files, followed by the streaming part of the production
+ * pipeline (sts_begin + sts_feed). One CSV line per test and input:
+ *
+ *   input,test,name,seconds,cycles_per_bit,peak_bytes,p_value
+ *
+ * seconds and cycles are the fastest of the repetitions; peak_bytes is the
+ * largest heap growth during a run, counted by the allocator wrappers below
+ * (the Makefile links with --wrap). cycles_per_bit comes from the perf cycle
+ * counter, from the TSC on x86 when perf is not available, and is empty
+ * otherwise.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "sts.h"
+
+#define INPUT_BYTES		(STS_SEQUENCE_BITS / 8)
+#define SKIP_BYTES		1		/* as nist_randomness_evaluate: the first byte is not tested */
+#define DEFAULT_REPS	3
+
+static const char* const test_names[STS_NUM_TESTS + 1] = {
+    "stream", "Frequency", "BlockFrequency", "CumulativeSums", "Runs",
+    "LongestRunOfOnes", "Rank", "DiscreteFourierTransform",
+    "NonOverlappingTemplateMatchings", "OverlappingTemplateMatchings",
+    "Universal", "ApproximateEntropy", "RandomExcursions",
+    "RandomExcursionsVariant", "Serial", "LinearComplexity"
+};
+
+/*
+ * Heap accounting: every block carries its size and the distance back to the
+ * start of the underlying allocation in a 16-byte header.
+ */
+typedef struct {
+    size_t size;
+    size_t offset;
+} alloc_header;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void  __real_free(void* ptr);
+int   __real_posix_memalign(void** ptr, size_t align, size_t size);
+
+static size_t heap_current, heap_peak;
+
+static void heap_add(size_t size)
+{
+    size_t cur = __atomic_add_fetch(&heap_current, size, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&heap_peak, __ATOMIC_RELAXED);
+
+    while (cur > peak && !__atomic_compare_exchange_n(&heap_peak, &peak, cur, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void* heap_track(void* base, size_t offset, size_t size)
+{
+    alloc_header* h;
+
+    if (base == NULL)
+        return NULL;
+    h = (alloc_header*)((char*)base + offset) - 1;
+    h->size = size;
+    h->offset = offset;
+    heap_add(size);
+    return (char*)base + offset;
+}
+
+void* __wrap_malloc(size_t size)
+{
+    return heap_track(__real_malloc(size + sizeof(alloc_header)), sizeof(alloc_header), size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    if (size && nmemb > (SIZE_MAX - sizeof(alloc_header)) / size)
+        return NULL;
+    return heap_track(__real_calloc(1, nmemb * size + sizeof(alloc_header)), sizeof(alloc_header), nmemb * size);
+}
+
+void __wrap_free(void* ptr)
+{
+    alloc_header* h;
+
+    if (ptr == NULL)
+        return;
+    h = (alloc_header*)ptr - 1;
+    __atomic_sub_fetch(&heap_current, h->size, __ATOMIC_RELAXED);
+    __real_free((char*)ptr - h->offset);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    void* p;
+    size_t old;
+
+    if (ptr == NULL)
+        return __wrap_malloc(size);
+    if ((p = __wrap_malloc(size)) == NULL)
+        return NULL;
+    old = ((alloc_header*)ptr - 1)->size;
+    memcpy(p, ptr, old < size ? old : size);
+    __wrap_free(ptr);
+    return p;
+}
+
+int __wrap_posix_memalign(void** ptr, size_t align, size_t size)
+{
+    void* base;
+    int ret;
+
+    if (align < sizeof(alloc_header))
+        align = sizeof(alloc_header);
+    if ((ret = __real_posix_memalign(&base, align, size + align)) != 0)
+        return ret;
+    *ptr = heap_track(base, align, size);
+    return 0;
+}
+
+/* cycle counter: perf if the kernel allows it, else the TSC, else none */
+static int cycles_fd = -1;
+static const char* cycles_source = "none";
+
+static void cycles_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cycles_fd >= 0)
+        cycles_source = "perf";
+#if defined(__x86_64__) || defined(__i386__)
+    else
+        cycles_source = "tsc";
+#endif
+}
+
+static uint64_t cycles_now(void)
+{
+    uint64_t count = 0;
+
+    if (cycles_fd >= 0) {
+        if (read(cycles_fd, &count, sizeof(count)) != sizeof(count))
+            count = 0;
+        return count;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static double seconds_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* fixed-seed input: splitmix64 */
+static void input_from_seed(unsigned char* rnd, uint64_t seed)
+{
+    uint64_t z = 0;
+    int i;
+
+    for (i = 0; i < INPUT_BYTES; i++) {
+        if (i % 8 == 0) {
+            z = (seed += UINT64_C(0x9E3779B97F4A7C15));
+            z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+            z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+            z ^= z >> 31;
+        }
+        rnd[i] = (unsigned char)(z >> (8 * (i % 8)));
+    }
+}
+
+static int input_from_file(unsigned char* rnd, const char* path)
+{
+    FILE* fp;
+    size_t len;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        fprintf(stderr, "stsbench: cannot open %s\n", path);
+        return -1;
+    }
+    len = fread(rnd, 1, INPUT_BYTES, fp);
+    fclose(fp);
+    if (len != INPUT_BYTES) {
+        fprintf(stderr, "stsbench: %s is shorter than %d bytes\n", path, INPUT_BYTES);
+        return -1;
+    }
+    return 0;
+}
+
+/* the tested bits as the streaming evaluator packs them, zero-padded to n bits */
+static void pack_input(BitWord* words, const unsigned char* rnd, int n)
+{
+    int i;
+
+    memset(words, 0, (n / 64 + 2) * sizeof(BitWord));
+    for (i = 0; i < n / 8 && SKIP_BYTES + i < INPUT_BYTES; i++)
+        words[i / 8] |= (BitWord)rnd[SKIP_BYTES + i] << (8 * (i % 8));
+}
+
+/* test 0 is the streaming part of the pipeline */
+static double run_test(int i, const unsigned char* rnd, const BitWord* words, int n, sts_workspace* ws)
+{
+    sts_ctx* ctx;
+
+    if (i > 0)
+        return sts_test(i, words, n);
+    if ((ctx = sts_begin(n, ws)) == NULL)
+        return -1.0;
+    sts_feed(ctx, rnd, INPUT_BYTES);
+    sts_free(ctx);
+    return -1.0;
+}
+
+/* each input gets its own workspace, so that its stream line shows the allocation */
+static int bench_input(const char* label, const unsigned char* rnd, const BitWord* words, int reps, size_t budget)
+{
+    int i, r, n = STS_SEQUENCE_BITS;
+    double t, best, p_value = 0;
+    uint64_t c, best_cycles;
+    size_t base, peak;
+    sts_workspace* ws;
+
+    if ((ws = sts_workspace_create(budget)) == NULL)
+        return -1;
+    for (i = 0; i <= STS_NUM_TESTS; i++) {
+        best = 0;
+        best_cycles = 0;
+        peak = 0;
+        for (r = 0; r < reps; r++) {
+            base = __atomic_load_n(&heap_current, __ATOMIC_RELAXED);
+            __atomic_store_n(&heap_peak, base, __ATOMIC_RELAXED);
+            c = cycles_now();
+            t = seconds_now();
+            p_value = run_test(i, rnd, words, n, ws);
+            t = seconds_now() - t;
+            c = cycles_now() - c;
+            if (r == 0 || t < best) {
+                best = t;
+                best_cycles = c;
+            }
+            if (__atomic_load_n(&heap_peak, __ATOMIC_RELAXED) - base > peak)
+                peak = __atomic_load_n(&heap_peak, __ATOMIC_RELAXED) - base;
+        }
+        printf("%s,%d,%s,%.6f,", label, i, test_names[i], best);
+        if (strcmp(cycles_source, "none") != 0)
+            printf("%.3f", (double)best_cycles / n);
+        printf(",%zu,", peak);
+        if (i > 0)
+            printf("%.17g", p_value);
+        printf("\n");
+        fflush(stdout);
+    }
+    sts_workspace_free(ws);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage: stsbench [-r reps] [-b budget_mb] [-s seed]... [file]...\n"
+        "  Runs the %d NIST tests on each 1 MiB input (seed 1 if none is given)\n"
+        "  and prints one CSV line per test.\n"
+        "  -r  repetitions per test, the fastest is reported (default %d)\n"
+        "  -b  workspace budget of the streaming pipeline in MB (default no limit)\n"
+        "  -s  fixed-seed input, may be repeated\n", STS_NUM_TESTS, DEFAULT_REPS);
+}
+
+int main(int argc, char** argv)
+{
+    static unsigned char rnd[INPUT_BYTES];
+    BitWord* words;
+    char label[64];
+    const char** seeds;
+    int opt, reps = DEFAULT_REPS, nseeds = 0, ret = 0, i;
+    size_t budget = 0;
+
+    if (((words = (BitWord*)malloc((STS_SEQUENCE_BITS / 64 + 2) * sizeof(BitWord))) == NULL) ||
+        ((seeds = (const char**)malloc(argc * sizeof(char*))) == NULL))
+        return 1;
+
+    while ((opt = getopt(argc, argv, "r:b:s:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            reps = atoi(optarg) > 0 ? atoi(optarg) : 1;
+            break;
+        case 'b':
+            budget = (size_t)(atof(optarg) * 1024 * 1024);
+            break;
+        case 's':
+            seeds[nseeds++] = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (nseeds == 0 && optind == argc)
+        seeds[nseeds++] = "1";
+
+    cycles_open();
+    fprintf(stderr, "stsbench: %d repetitions, cycles from %s\n", reps, cycles_source);
+    printf("input,test,name,seconds,cycles_per_bit,peak_bytes,p_value\n");
+
+    for (i = 0; i < nseeds; i++) {
+        input_from_seed(rnd, strtoull(seeds[i], NULL, 0));
+        pack_input(words, rnd, STS_SEQUENCE_BITS);
+        snprintf(label, sizeof(label), "seed:%s", seeds[i]);
+        if (bench_input(label, rnd, words, reps, budget))
+            ret = 1;
+    }
+    for (i = optind; i < argc; i++) {
+        if (input_from_file(rnd, argv[i])) {
+            ret = 1;
+            continue;
+        }
+        pack_input(words, rnd, STS_SEQUENCE_BITS);
+        if (bench_input(argv[i], rnd, words, reps, budget))
+            ret = 1;
+    }
+
+    free(seeds);
+    free(words);
+    return ret;
+}